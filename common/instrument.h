@@ -0,0 +1,475 @@
+// Shared hot-path instrumentation for the labs: per-thread counters, log-linear
+// (HDR-style) latency histograms and scoped trace spans. Results can be printed as a
+// text report or written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+//   INSTR_SPAN("lab2.Ship::load");             // times the rest of the enclosing scope
+//   INSTR_COUNT("lab2.Ship::load.loaded");     // +1 on a per-thread counter
+//   INSTR_ADD("lab4.Table::insertBatch.rows", n); // +n
+//
+// Names must be string literals (or otherwise live for the whole program).
+// Build with -DINSTRUMENT_OFF to compile every macro out. At run time:
+//   INSTRUMENT_REPORT=1     print counters and latency percentiles to stderr at exit
+//   INSTRUMENT_TRACE=file   also record each span and write a Chrome trace to `file` at exit
+//
+// Hot-path cost with tracing off: two TSC reads per span (steady_clock off x86, or where
+// the TSC is not invariant: -DINSTRUMENT_STEADY_CLOCK), plus a few uncontended stores into the
+// calling thread's own slab (no locked RMW, no sharing). Ticks become ns only on export.
+// Header-only so that each lab still builds from its single main.cpp.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(INSTRUMENT_STEADY_CLOCK)
+#include <x86intrin.h>
+#define INSTRUMENT_TSC 1
+#endif
+
+namespace instrument {
+
+constexpr std::size_t kMaxCounters = 256;
+constexpr std::size_t kMaxHistograms = 64;
+// 16 linear sub-buckets per power of two: every recorded value is within 6.25% of its bucket
+constexpr unsigned kSubBucketBits = 4;
+constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+constexpr std::size_t kHistogramBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+constexpr std::size_t kTraceChunk = 4096;
+constexpr std::size_t kMaxTraceChunks = 256; // ~1M spans per thread; later ones are counted as dropped
+
+inline std::uint64_t steadyNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline std::uint64_t ticks() {
+#ifdef INSTRUMENT_TSC
+    return __rdtsc();
+#else
+    return steadyNs();
+#endif
+}
+
+inline const std::uint64_t kEpochNs = steadyNs();
+inline const std::uint64_t kEpochTicks = ticks();
+
+// Calibrates ticks against steady_clock over the whole run so far (at least 1 ms).
+inline double nsPerTick() {
+#ifdef INSTRUMENT_TSC
+    std::uint64_t ns, t;
+    do {
+        ns = steadyNs();
+        t = ticks();
+    } while (ns - kEpochNs < 1000000);
+    return static_cast<double>(ns - kEpochNs) / static_cast<double>(t - kEpochTicks);
+#else
+    return 1.0;
+#endif
+}
+
+// Values below kSubBuckets get their own bucket; above that, bucket = (exponent, top 4 bits after the leading one).
+inline std::size_t bucketOf(std::uint64_t v) {
+    if (v < kSubBuckets) return static_cast<std::size_t>(v);
+    const unsigned e = 63u - static_cast<unsigned>(__builtin_clzll(v));
+    return (e - kSubBucketBits + 1) * kSubBuckets + ((v >> (e - kSubBucketBits)) & (kSubBuckets - 1));
+}
+
+inline std::uint64_t bucketLow(std::size_t b) {
+    if (b < kSubBuckets) return b;
+    const unsigned e = static_cast<unsigned>(b / kSubBuckets) + kSubBucketBits - 1;
+    return (kSubBuckets + b % kSubBuckets) << (e - kSubBucketBits);
+}
+
+inline std::uint64_t bucketHigh(std::size_t b) {
+    return b + 1 < kHistogramBuckets ? bucketLow(b + 1) - 1 : UINT64_MAX;
+}
+
+struct TraceEvent {
+    std::uint64_t start; // ticks since kEpochTicks
+    std::uint64_t duration;
+    std::uint32_t site;  // histogram id of the span
+    std::uint32_t tid;
+};
+
+// Everything one thread records. Only the owning thread writes (plain load + store on
+// relaxed atomics), readers can aggregate at any time without stopping it.
+struct Slab {
+    std::array<std::atomic<std::uint64_t>, kMaxCounters> counters;
+    // Per histogram: kHistogramBuckets counts followed by the sum of values, allocated on first use
+    std::array<std::atomic<std::atomic<std::uint64_t>*>, kMaxHistograms> histograms;
+    std::array<std::atomic<TraceEvent*>, kMaxTraceChunks> trace;
+    std::atomic<std::size_t> traced;
+    std::atomic<std::uint64_t> dropped;
+    std::uint32_t tid = 0;
+
+    ~Slab() {
+        for (auto& h : histograms) delete[] h.load();
+        for (auto& t : trace) delete[] t.load();
+    }
+};
+
+inline void bump(std::atomic<std::uint64_t>& c, std::uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline std::atomic<bool> tracing{false};
+
+// Names and slabs. Slabs live until exit: an exiting thread returns its slab to the idle
+// list and the next new thread reuses it, so totals survive and memory stays bounded.
+class Registry {
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Slab>> slabs;
+    std::vector<Slab*> idle;
+    std::array<const char*, kMaxCounters> counterNames{};
+    std::array<const char*, kMaxHistograms> histogramNames{};
+    std::array<bool, kMaxHistograms> histogramTimed{}; // values are ticks, reported as ns
+    std::size_t counterCount = 0, histogramCount = 0;
+    std::uint32_t nextTid = 1;
+
+    template <std::size_t N>
+    static std::uint32_t enroll(std::array<const char*, N>& names, std::size_t& count, const char* name) {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (std::strcmp(names[i], name) == 0) return static_cast<std::uint32_t>(i);
+        }
+        if (count == N - 1) names[count++] = "instrument.overflow"; // last slot collects the excess
+        if (count == N) return static_cast<std::uint32_t>(N - 1);
+        names[count] = name;
+        return static_cast<std::uint32_t>(count++);
+    }
+
+public:
+    std::uint32_t counterId(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return enroll(counterNames, counterCount, name);
+    }
+
+    std::uint32_t histogramId(const char* name, bool timed) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::uint32_t id = enroll(histogramNames, histogramCount, name);
+        histogramTimed[id] = timed;
+        return id;
+    }
+
+    Slab* acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        Slab* slab;
+        if (!idle.empty()) {
+            slab = idle.back();
+            idle.pop_back();
+        } else {
+            slabs.push_back(std::unique_ptr<Slab>(new Slab()));
+            slab = slabs.back().get();
+        }
+        slab->tid = nextTid++;
+        return slab;
+    }
+
+    void release(Slab* slab) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(slab);
+    }
+
+    // fn(registry) under the registry lock; recording threads are not blocked.
+    template <typename Fn>
+    void read(Fn fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fn(*this);
+    }
+
+    std::size_t counters() const { return counterCount; }
+    const char* counterName(std::size_t i) const { return counterNames[i]; }
+    std::size_t histograms() const { return histogramCount; }
+    const char* histogramName(std::size_t i) const { return histogramNames[i]; }
+    bool isTimed(std::size_t i) const { return histogramTimed[i]; }
+    const std::vector<std::unique_ptr<Slab>>& allSlabs() const { return slabs; }
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+struct ThreadSlab {
+    Slab* slab = registry().acquire();
+    ~ThreadSlab() { registry().release(slab); }
+};
+
+inline Slab& localSlab() {
+    thread_local ThreadSlab handle;
+    return *handle.slab;
+}
+
+class Counter {
+private:
+    std::uint32_t id;
+public:
+    explicit Counter(const char* name) : id(registry().counterId(name)) {}
+    void add(std::uint64_t n = 1) const { bump(localSlab().counters[id], n); }
+};
+
+class Histogram {
+private:
+    std::uint32_t id;
+public:
+    // timed == true for span sites: values are ticks and get converted to ns on export
+    explicit Histogram(const char* name, bool timed = false) : id(registry().histogramId(name, timed)) {}
+
+    void record(std::uint64_t value) const {
+        auto& slot = localSlab().histograms[id];
+        std::atomic<std::uint64_t>* buckets = slot.load(std::memory_order_acquire);
+        if (!buckets) {
+            buckets = new std::atomic<std::uint64_t>[kHistogramBuckets + 1]();
+            slot.store(buckets, std::memory_order_release);
+        }
+        bump(buckets[bucketOf(value)], 1);
+        bump(buckets[kHistogramBuckets], value);
+    }
+
+    std::uint32_t getId() const { return id; }
+};
+
+inline void recordTrace(std::uint32_t site, std::uint64_t start, std::uint64_t duration) {
+    Slab& slab = localSlab();
+    const std::size_t n = slab.traced.load(std::memory_order_relaxed);
+    const std::size_t chunk = n / kTraceChunk;
+    if (chunk >= kMaxTraceChunks) {
+        bump(slab.dropped, 1);
+        return;
+    }
+    TraceEvent* events = slab.trace[chunk].load(std::memory_order_relaxed);
+    if (!events) {
+        events = new TraceEvent[kTraceChunk];
+        slab.trace[chunk].store(events, std::memory_order_relaxed);
+    }
+    events[n % kTraceChunk] = TraceEvent{start, duration, site, slab.tid};
+    slab.traced.store(n + 1, std::memory_order_release); // publishes the event to readers
+}
+
+// Times its scope into the site's histogram; with tracing on, also logs a trace event.
+class Span {
+private:
+    const Histogram& site;
+    std::uint64_t start;
+public:
+    explicit Span(const Histogram& s) : site(s), start(ticks()) {}
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    ~Span() {
+        const std::uint64_t duration = ticks() - start;
+        site.record(duration);
+        if (tracing.load(std::memory_order_relaxed)) recordTrace(site.getId(), start - kEpochTicks, duration);
+    }
+};
+
+// ---- Aggregation and export ----
+
+struct HistogramSummary {
+    const char* name;
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    double scale = 1.0; // ns per recorded unit (nsPerTick() for spans)
+    std::array<std::uint64_t, kHistogramBuckets> buckets{};
+
+    double mean() const { return count ? static_cast<double>(sum) * scale / count : 0.0; }
+
+    // Upper edge of the bucket holding the q-quantile (HDR's "highest equivalent value").
+    std::uint64_t percentile(double q) const {
+        if (count == 0) return 0;
+        const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        std::uint64_t seen = 0;
+        std::size_t b = 0;
+        for (; b + 1 < kHistogramBuckets; ++b) {
+            seen += buckets[b];
+            if (seen >= rank) break;
+        }
+        return static_cast<std::uint64_t>(static_cast<double>(bucketHigh(b)) * scale);
+    }
+
+    std::uint64_t max() const { return percentile(1.0); }
+};
+
+struct Snapshot {
+    std::vector<std::pair<const char*, std::uint64_t>> counters;
+    std::vector<HistogramSummary> histograms;
+    std::uint64_t droppedSpans = 0;
+    double nsPerTick = 1.0;
+};
+
+// Sums every thread's slab; safe to call while other threads keep recording.
+inline Snapshot snapshot() {
+    Snapshot snap;
+    snap.nsPerTick = nsPerTick();
+    registry().read([&](const Registry& reg) {
+        const std::size_t counterCount = reg.counters(), histogramCount = reg.histograms();
+        snap.counters.resize(counterCount);
+        for (std::size_t i = 0; i < counterCount; ++i) snap.counters[i] = {reg.counterName(i), 0};
+        snap.histograms.resize(histogramCount);
+        for (std::size_t h = 0; h < histogramCount; ++h) {
+            snap.histograms[h].name = reg.histogramName(h);
+            snap.histograms[h].scale = reg.isTimed(h) ? snap.nsPerTick : 1.0;
+        }
+
+        for (const auto& slab : reg.allSlabs()) {
+            for (std::size_t i = 0; i < counterCount; ++i)
+                snap.counters[i].second += slab->counters[i].load(std::memory_order_relaxed);
+            for (std::size_t h = 0; h < histogramCount; ++h) {
+                const auto* buckets = slab->histograms[h].load(std::memory_order_acquire);
+                if (!buckets) continue;
+                HistogramSummary& out = snap.histograms[h];
+                for (std::size_t b = 0; b < kHistogramBuckets; ++b) {
+                    const std::uint64_t c = buckets[b].load(std::memory_order_relaxed);
+                    out.buckets[b] += c;
+                    out.count += c;
+                }
+                out.sum += buckets[kHistogramBuckets].load(std::memory_order_relaxed);
+            }
+            snap.droppedSpans += slab->dropped.load(std::memory_order_relaxed);
+        }
+    });
+    return snap;
+}
+
+inline void writeReport(std::ostream& out) {
+    const Snapshot snap = snapshot();
+    char line[256];
+    if (!snap.counters.empty()) {
+        std::snprintf(line, sizeof line, "%-44s %14s\n", "counter", "value");
+        out << line;
+        for (const auto& c : snap.counters) {
+            std::snprintf(line, sizeof line, "%-44s %14llu\n", c.first, static_cast<unsigned long long>(c.second));
+            out << line;
+        }
+    }
+    if (!snap.histograms.empty()) {
+        std::snprintf(line, sizeof line, "%-44s %10s %10s %10s %10s %10s %10s  (ns)\n", "span", "count", "mean",
+                      "p50", "p90", "p99", "max");
+        out << line;
+        for (const auto& h : snap.histograms) {
+            std::snprintf(line, sizeof line, "%-44s %10llu %10.0f %10llu %10llu %10llu %10llu\n", h.name,
+                          static_cast<unsigned long long>(h.count), h.mean(),
+                          static_cast<unsigned long long>(h.percentile(0.50)),
+                          static_cast<unsigned long long>(h.percentile(0.90)),
+                          static_cast<unsigned long long>(h.percentile(0.99)),
+                          static_cast<unsigned long long>(h.max()));
+            out << line;
+        }
+    }
+    if (snap.droppedSpans) out << "trace buffer full: " << snap.droppedSpans << " span(s) not recorded\n";
+}
+
+inline void writeJsonString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        if (static_cast<unsigned char>(*s) >= 0x20) out << *s;
+    }
+    out << '"';
+}
+
+// Chrome trace event format: one complete ("X") event per recorded span, thread-name
+// metadata, and the final counter values as counter ("C") events.
+inline void writeChromeTrace(std::ostream& out) {
+    const Snapshot snap = snapshot();
+    std::vector<const char*> siteNames;
+    for (const auto& h : snap.histograms) siteNames.push_back(h.name);
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto next = [&]() -> std::ostream& {
+        if (!first) out << ",\n";
+        first = false;
+        return out;
+    };
+    char num[96];
+    const double usPerTick = snap.nsPerTick / 1e3;
+    std::uint64_t lastTs = 0;
+    std::vector<std::uint32_t> tids;
+
+    registry().read([&](const Registry& reg) {
+        for (const auto& slab : reg.allSlabs()) {
+            const std::size_t n = slab->traced.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < n; ++i) {
+                const TraceEvent& e = slab->trace[i / kTraceChunk].load(std::memory_order_relaxed)[i % kTraceChunk];
+                if (std::find(tids.begin(), tids.end(), e.tid) == tids.end()) tids.push_back(e.tid);
+                next() << "{\"name\":";
+                writeJsonString(out, e.site < siteNames.size() ? siteNames[e.site] : "?");
+                std::snprintf(num, sizeof num, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", e.start * usPerTick,
+                              e.duration * usPerTick);
+                out << num << ",\"pid\":1,\"tid\":" << e.tid << '}';
+                lastTs = std::max(lastTs, e.start + e.duration);
+            }
+        }
+    });
+    for (std::uint32_t tid : tids) {
+        next() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+               << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+    }
+    std::snprintf(num, sizeof num, "%.3f", lastTs * usPerTick);
+    for (const auto& c : snap.counters) {
+        next() << "{\"name\":";
+        writeJsonString(out, c.first);
+        out << ",\"ph\":\"C\",\"ts\":" << num << ",\"pid\":1,\"args\":{\"value\":" << c.second << "}}";
+    }
+    out << "]}\n";
+}
+
+// Reads INSTRUMENT_TRACE / INSTRUMENT_REPORT at startup and exports at exit. Touching the
+// registry first makes it outlive this object (statics are destroyed in reverse order).
+struct ExitExport {
+    std::string tracePath;
+    bool report = false;
+
+    ExitExport() {
+        registry();
+        if (const char* path = std::getenv("INSTRUMENT_TRACE"); path && *path) {
+            tracePath = path;
+            tracing.store(true);
+        }
+        if (const char* r = std::getenv("INSTRUMENT_REPORT"); r && *r && std::strcmp(r, "0") != 0) report = true;
+    }
+
+    ~ExitExport() {
+        if (report) writeReport(std::cerr);
+        if (!tracePath.empty()) {
+            std::ofstream f(tracePath);
+            writeChromeTrace(f);
+            if (!f) std::cerr << "instrument: cannot write " << tracePath << "\n";
+        }
+    }
+};
+
+inline ExitExport exitExport;
+
+} // namespace instrument
+
+#define INSTR_CONCAT_(a, b) a##b
+#define INSTR_CONCAT(a, b) INSTR_CONCAT_(a, b)
+
+#ifdef INSTRUMENT_OFF
+#define INSTR_SPAN(name) ((void)0)
+#define INSTR_COUNT(name) ((void)0)
+#define INSTR_ADD(name, n) ((void)0)
+#else
+#define INSTR_SPAN(name)                                                               \
+    static const ::instrument::Histogram INSTR_CONCAT(instr_site_, __LINE__)(name, true); \
+    const ::instrument::Span INSTR_CONCAT(instr_span_, __LINE__)(INSTR_CONCAT(instr_site_, __LINE__))
+#define INSTR_ADD(name, n)                                                             \
+    do {                                                                               \
+        static const ::instrument::Counter instr_counter_(name);                       \
+        instr_counter_.add(static_cast<std::uint64_t>(n));                             \
+    } while (0)
+#define INSTR_COUNT(name) INSTR_ADD(name, 1)
+#endif
@@ -3,36 +3,204 @@
 #include <memory>
 #include <string>
 #include <iomanip>
+#include <span>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <string_view>
+#include <unordered_set>
+#include <new>
+#include <functional>
+#include <chrono>
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../../common/instrument.h"
 
 using namespace std;
 class Customer;
 
+// Amounts are kept as integer cents in atomics, so several threads can charge the
+// same bill without a mutex: tryCharge reserves the amount with a CAS loop only if
+// the new debt stays within the limit.
 class Bill {
 private:
-    double limitingAmount;
-    double currentDebt;
+    atomic<int64_t> limitingCents;
+    atomic<int64_t> debtCents;
+
+    static int64_t toCents(double amount) { return llround(amount * 100); }
+    static double fromCents(int64_t cents) { return cents / 100.0; }
 public:
-    Bill(double limit) : limitingAmount(limit), currentDebt(0.0) {}
+    Bill(double limit) : limitingCents(toCents(limit)), debtCents(0) {}
+
+    // Advisory only: another thread may charge between check() and add().
+    // Use tryCharge() to check and charge in one step.
+    bool check(double amount) const {
+        return debtCents.load(memory_order_relaxed) + toCents(amount) <= limitingCents.load(memory_order_relaxed);
+    }
 
-    bool check(double amount) {
-        return (currentDebt + amount <= limitingAmount);
+    bool tryCharge(double amount) {
+        const int64_t cents = toCents(amount);
+        int64_t debt = debtCents.load(memory_order_relaxed);
+        do {
+            if (debt + cents > limitingCents.load(memory_order_relaxed)) return false;
+        } while (!debtCents.compare_exchange_weak(debt, debt + cents, memory_order_relaxed));
+        return true;
     }
 
     void add(double amount) {
-        currentDebt += amount;
+        debtCents.fetch_add(toCents(amount), memory_order_relaxed);
     }
 
     void pay(double amount) {
-        if (amount > currentDebt) amount = currentDebt;
-        currentDebt -= amount;
+        const int64_t cents = toCents(amount);
+        int64_t debt = debtCents.load(memory_order_relaxed);
+        while (!debtCents.compare_exchange_weak(debt, debt - min(cents, debt), memory_order_relaxed)) {}
     }
 
     void changeTheLimit(double amount) {
-        limitingAmount = amount;
+        limitingCents.store(toCents(amount), memory_order_relaxed);
     }
 
-    double getLimitingAmount() const { return limitingAmount; }
-    double getCurrentDebt() const { return currentDebt; }
+    double getLimitingAmount() const { return fromCents(limitingCents.load(memory_order_relaxed)); }
+    double getCurrentDebt() const { return fromCents(debtCents.load(memory_order_relaxed)); }
+};
+
+// One call detail record (CDR) to be rated by the caller's operator.
+// quantity is minutes for Talk, message count for Message and MB for Network.
+enum class CallKind : uint8_t { Talk, Message, Network };
+
+struct CallRecord {
+    CallKind kind;
+    double quantity;
+    int callerAge;
+    int calleeOperatorId; // only used for Message
+    double cost = 0.0;    // filled in by Operator::rateCalls
+};
+
+enum class ChargeResult { Charged, LimitExceeded };
+
+struct RejectionEvent {
+    CallKind kind;
+    int customerId;
+    int operatorId;
+    double amount;
+};
+
+// Collects rejected charges off the charging path. Producers push into a bounded
+// lock-free ring (per-slot sequence numbers, multi-producer/single-consumer) and
+// never block: if the ring is full the event is dropped and only counted. A
+// background thread drains the ring, hands each event to the handler and keeps
+// the counters by call kind and operator.
+class RejectionSink {
+public:
+    using Handler = function<void(const RejectionEvent&)>;
+    static constexpr size_t kMaxTrackedOperators = 64; // larger ids share the last counter
+private:
+    struct Slot {
+        atomic<size_t> sequence;
+        RejectionEvent event;
+    };
+
+    vector<Slot> ring;
+    size_t mask;
+    alignas(64) atomic<size_t> tail{0};
+    alignas(64) size_t head = 0; // only touched by the drain thread
+    Handler handler;
+    atomic<bool> stopping{false};
+    thread drainer;
+
+    array<atomic<uint64_t>, 3> byKind{};
+    array<atomic<uint64_t>, kMaxTrackedOperators> byOperator{};
+    array<atomic<uint64_t>, 3> droppedByKind{};
+
+    static size_t operatorSlot(int operatorId) {
+        return min<size_t>(static_cast<size_t>(max(operatorId, 0)), kMaxTrackedOperators - 1);
+    }
+
+    bool tryPop(RejectionEvent& out) {
+        Slot& slot = ring[head & mask];
+        if (slot.sequence.load(memory_order_acquire) != head + 1) return false;
+        out = slot.event;
+        slot.sequence.store(head + ring.size(), memory_order_release);
+        ++head;
+        return true;
+    }
+
+    void drain() {
+        RejectionEvent event;
+        for (;;) {
+            // Read the flag before draining: everything published before stop() is then seen.
+            const bool last = stopping.load(memory_order_acquire);
+            bool any = false;
+            while (tryPop(event)) {
+                any = true;
+                byKind[static_cast<size_t>(event.kind)].fetch_add(1, memory_order_relaxed);
+                byOperator[operatorSlot(event.operatorId)].fetch_add(1, memory_order_relaxed);
+                if (handler) handler(event);
+            }
+            if (last) return;
+            if (!any) this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+public:
+    // capacity is rounded up to a power of two.
+    explicit RejectionSink(Handler h = nullptr, size_t capacity = 4096) : handler(move(h)) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        ring = vector<Slot>(size);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) ring[i].sequence.store(i, memory_order_relaxed);
+        drainer = thread([this] { drain(); });
+    }
+
+    RejectionSink(const RejectionSink&) = delete;
+    RejectionSink& operator=(const RejectionSink&) = delete;
+    ~RejectionSink() { stop(); }
+
+    // Called from the charging path; never blocks.
+    bool publish(const RejectionEvent& event) {
+        size_t pos = tail.load(memory_order_relaxed);
+        for (;;) {
+            Slot& slot = ring[pos & mask];
+            const size_t sequence = slot.sequence.load(memory_order_acquire);
+            const auto diff = static_cast<ptrdiff_t>(sequence - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    slot.event = event;
+                    slot.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                droppedByKind[static_cast<size_t>(event.kind)].fetch_add(1, memory_order_relaxed);
+                return false;
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Drains everything published before the call and stops the background thread.
+    void stop() {
+        if (!drainer.joinable()) return;
+        stopping.store(true, memory_order_release);
+        drainer.join();
+    }
+
+    // Counters include only drained events; dropped events are counted separately.
+    uint64_t rejections(CallKind kind) const { return byKind[static_cast<size_t>(kind)].load(memory_order_relaxed); }
+    uint64_t rejectionsForOperator(int operatorId) const {
+        return byOperator[operatorSlot(operatorId)].load(memory_order_relaxed);
+    }
+    uint64_t dropped(CallKind kind) const { return droppedByKind[static_cast<size_t>(kind)].load(memory_order_relaxed); }
 };
 
 class Operator;
@@ -44,6 +212,7 @@ private:
     double messageCost;
     double networkCharge;
     int discountRate; // percentage
+    RejectionSink* sink = nullptr; // where this operator's customers report rejected charges
 public:
     Operator(int ID, double talk, double msg, double net, int discount)
         : ID(ID), talkingCharge(talk), messageCost(msg),
@@ -53,40 +222,51 @@ public:
     double calculateMessageCost(int quantity, const Customer& customer, const Customer& other) const;
     double calculateNetworkCost(double amount) const;
 
+    // Rates a batch of CDRs in place. Same results as the per-call functions above, but the
+    // records are transposed block by block into struct-of-arrays and discounts are applied
+    // as masks, so the inner loops have no per-record branches and can be vectorized.
+    void rateCalls(span<CallRecord> records) const;
+
     double getTalkingCharge() const { return talkingCharge; }
     double getMessageCost() const { return messageCost; }
     double getNetworkCharge() const { return networkCharge; }
     int getDiscountRate() const { return discountRate; }
     int getId() const { return ID; }
+
+    void setRejectionSink(RejectionSink* s) { sink = s; }
+    void reportRejection(CallKind kind, int customerId, double amount) const {
+        if (sink) sink->publish({kind, customerId, ID, amount});
+    }
 };
 
+// Fields used when charging come first, so a charge reads one line of the customer
+// and one of the bill. The name points into a StringPool and is only read for output.
 class Customer {
 private:
     int ID;
-    string name;
     int age;
     Operator* op; // aggregation: customer uses an operator
     Bill* bill;   // aggregation: customer has a bill
+    string_view name;
 public:
-    Customer(int ID, string name, int age, Operator* op, Bill* bill, double limit)
-        : ID(ID), name(name), age(age), op(op), bill(bill) {}
-
-    void talk(int minute, Customer& other) {
-        double cost = op->calculateTalkingCost(minute, *this);
-        if (bill->check(cost)) bill->add(cost);
-        else cout << "Limit exceeded. Talk not allowed.\n";
+    Customer(int ID, string_view name, int age, Operator* op, Bill* bill, double limit)
+        : ID(ID), age(age), op(op), bill(bill), name(name) {}
+
+    // A rejected charge is returned to the caller and reported to the operator's
+    // RejectionSink; nothing is printed on this path.
+    ChargeResult talk(int minute, Customer& other) {
+        INSTR_SPAN("lab1.Customer::talk");
+        const ChargeResult result = charge(CallKind::Talk, op->calculateTalkingCost(minute, *this));
+        if (result == ChargeResult::LimitExceeded) INSTR_COUNT("lab1.Customer::talk.rejected");
+        return result;
     }
 
-    void message(int quantity, Customer& other) {
-        double cost = op->calculateMessageCost(quantity, *this, other);
-        if (bill->check(cost)) bill->add(cost);
-        else cout << "Limit exceeded. Message not sent.\n";
+    ChargeResult message(int quantity, Customer& other) {
+        return charge(CallKind::Message, op->calculateMessageCost(quantity, *this, other));
     }
 
-    void connection(double amount) {
-        double cost = op->calculateNetworkCost(amount);
-        if (bill->check(cost)) bill->add(cost);
-        else cout << "Limit exceeded. Connection denied.\n";
+    ChargeResult connection(double amount) {
+        return charge(CallKind::Network, op->calculateNetworkCost(amount));
     }
 
     void pay(double amount) {
@@ -102,9 +282,16 @@ public:
     }
     int getAge() const { return age; }
     int getId() const { return ID; }
-    string getName() const { return name; }
+    string getName() const { return string(name); }
     Operator* getOperator() const { return op; }
     Bill* getBill() const { return bill; }
+
+    // Charges an already rated cost (used by the ingestion pipeline).
+    ChargeResult charge(CallKind kind, double cost) {
+        if (bill->tryCharge(cost)) return ChargeResult::Charged;
+        op->reportRejection(kind, ID, cost);
+        return ChargeResult::LimitExceeded;
+    }
 };
 
 double Operator::calculateTalkingCost(int minute, const Customer& customer) const {
@@ -126,19 +313,608 @@ double Operator::calculateNetworkCost(double amount) const {
     return networkCharge * amount;
 }
 
-int main() {
-    vector<unique_ptr<Customer>> customers;
-    vector<unique_ptr<Operator>> operators;
-    vector<unique_ptr<Bill>> bills;
+void Operator::rateCalls(span<CallRecord> records) const {
+    constexpr size_t kBlock = 256;
+    const double rates[] = {talkingCharge, messageCost, networkCharge};
+    const double discounted = 1 - discountRate / 100.0;
+
+    double quantity[kBlock], rate[kBlock], cost[kBlock];
+    int32_t age[kBlock], kind[kBlock], callee[kBlock];
+    for (size_t from = 0; from < records.size(); from += kBlock) {
+        const size_t n = min(kBlock, records.size() - from);
+        const CallRecord* in = records.data() + from;
+        for (size_t i = 0; i < n; ++i) {
+            kind[i] = static_cast<int32_t>(in[i].kind);
+            quantity[i] = in[i].quantity;
+            age[i] = in[i].callerAge;
+            callee[i] = in[i].calleeOperatorId;
+            rate[i] = rates[kind[i]];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const bool talkDiscount = (kind[i] == static_cast<int32_t>(CallKind::Talk)) & ((age[i] < 18) | (age[i] > 65));
+            const bool messageDiscount = (kind[i] == static_cast<int32_t>(CallKind::Message)) & (callee[i] == ID);
+            const double base = rate[i] * quantity[i];
+            cost[i] = (talkDiscount | messageDiscount) ? base * discounted : base;
+        }
+        for (size_t i = 0; i < n; ++i) records[from + i].cost = cost[i];
+    }
+}
+
+// Elements are constructed in place in fixed-size blocks and never move, so pointers
+// and indices into the arena stay valid as it grows. One allocation per block instead
+// of one per entity.
+template <typename T, size_t BlockSize = 4096>
+class Arena {
+private:
+    vector<T*> blocks;
+    size_t count = 0;
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        for (size_t i = 0; i < count; ++i) (*this)[i].~T();
+        for (T* block : blocks) ::operator delete(block, align_val_t(alignof(T)));
+    }
+
+    template <typename... Args>
+    size_t emplace(Args&&... args) {
+        if (count == blocks.size() * BlockSize) {
+            blocks.push_back(static_cast<T*>(::operator new(sizeof(T) * BlockSize, align_val_t(alignof(T)))));
+        }
+        new (blocks[count / BlockSize] + count % BlockSize) T(std::forward<Args>(args)...);
+        return count++;
+    }
+
+    T& operator[](size_t i) { return blocks[i / BlockSize][i % BlockSize]; }
+    const T& operator[](size_t i) const { return blocks[i / BlockSize][i % BlockSize]; }
+    size_t size() const { return count; }
+};
+
+// Interns strings into large character blocks. Equal strings share one copy and the
+// returned views stay valid for the lifetime of the pool.
+class StringPool {
+private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    char* current = nullptr;
+    size_t used = kBlockSize;
+    unordered_set<string_view> interned;
+public:
+    string_view intern(string_view s) {
+        auto it = interned.find(s);
+        if (it != interned.end()) return *it;
+        char* dest;
+        if (s.size() > kBlockSize / 4) {
+            // Long strings get their own block so they don't waste the current one.
+            blocks.push_back(make_unique<char[]>(s.size()));
+            dest = blocks.back().get();
+        } else {
+            if (used + s.size() > kBlockSize) {
+                blocks.push_back(make_unique<char[]>(kBlockSize));
+                current = blocks.back().get();
+                used = 0;
+            }
+            dest = current + used;
+            used += s.size();
+        }
+        copy(s.begin(), s.end(), dest);
+        return *interned.insert(string_view(dest, s.size())).first;
+    }
+
+    size_t size() const { return interned.size(); }
+};
 
-    operators.push_back(make_unique<Operator>(0, 0.5, 0.2, 0.1, 10));
-    operators.push_back(make_unique<Operator>(1, 0.6, 0.25, 0.15, 15));
+struct OperatorHandle { uint32_t index; };
+struct CustomerHandle { uint32_t index; };
 
-    bills.push_back(make_unique<Bill>(100.0));
-    bills.push_back(make_unique<Bill>(150.0));
+// Owns all operators, bills and customers. Entities are addressed by index handles;
+// each customer's bill is created alongside it in the bill arena.
+class SubscriberStore {
+private:
+    Arena<Operator> operators;
+    Arena<Bill> bills;
+    Arena<Customer> customers;
+    StringPool names;
+public:
+    OperatorHandle addOperator(int ID, double talk, double msg, double net, int discount) {
+        return {static_cast<uint32_t>(operators.emplace(ID, talk, msg, net, discount))};
+    }
+
+    CustomerHandle addCustomer(int ID, string_view name, int age, OperatorHandle op, double limit) {
+        Bill* bill = &bills[bills.emplace(limit)];
+        return {static_cast<uint32_t>(customers.emplace(ID, names.intern(name), age, &operators[op.index], bill, limit))};
+    }
+
+    Operator& getOperator(OperatorHandle h) { return operators[h.index]; }
+    Customer& getCustomer(CustomerHandle h) { return customers[h.index]; }
+    size_t operatorCount() const { return operators.size(); }
+    size_t customerCount() const { return customers.size(); }
+    size_t distinctNames() const { return names.size(); }
+};
+
+// ---- Streaming CDR ingestion ----
+//
+// Wire format: the 4-byte magic "CDR1", then fixed 16-byte little-endian records.
+// caller/callee are customer indices in the SubscriberStore.
+struct WireCdr {
+    uint32_t caller;
+    uint32_t callee;
+    float quantity;
+    uint8_t kind; // CallKind
+    uint8_t reserved[3];
+};
+static_assert(sizeof(WireCdr) == 16, "WireCdr must stay 16 bytes");
+constexpr char kCdrMagic[4] = {'C', 'D', 'R', '1'};
+
+// Blocking queue with a fixed capacity: push() waits while the queue is full, which is
+// how a slow stage pushes back on the stage before it. close() wakes everyone up;
+// pop() returns nullopt once the queue is closed and empty.
+template <typename T>
+class BoundedQueue {
+private:
+    deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    mutex m;
+    condition_variable notEmpty, notFull;
+public:
+    explicit BoundedQueue(size_t cap) : capacity(cap) {}
+
+    void push(T item) {
+        unique_lock<mutex> lock(m);
+        notFull.wait(lock, [&] { return items.size() < capacity || closed; });
+        items.push_back(move(item));
+        notEmpty.notify_one();
+    }
 
-    customers.push_back(make_unique<Customer>(0, "Alice", 20, operators[0].get(), bills[0].get(), 100.0));
-    customers.push_back(make_unique<Customer>(1, "Bob", 70, operators[1].get(), bills[1].get(), 150.0));
+    optional<T> pop() {
+        unique_lock<mutex> lock(m);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) return nullopt;
+        T item = move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    void close() {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+struct IngestStats {
+    uint64_t records = 0;
+    uint64_t batches = 0;
+    uint64_t malformed = 0; // unknown customer index or call kind
+    uint64_t charged = 0;
+    uint64_t rejected = 0;
+    double seconds = 0;
+};
+
+// Three stages, each on its own thread, connected by bounded queues:
+//   reader   — read() into a reusable buffer, no per-record copies or allocations;
+//   rating   — decodes records straight from the buffer, groups them by the caller's
+//              operator and rates each group with Operator::rateCalls;
+//   charging — applies the rated costs to the bills.
+// Read buffers circulate through a free list, so memory stays bounded by
+// kBuffers * kBatchRecords records no matter how far the charging stage falls behind.
+class CdrPipeline {
+public:
+    static constexpr size_t kBatchRecords = 16384;
+    static constexpr size_t kBuffers = 8;
+private:
+    struct RawBatch {
+        vector<char> buffer;
+        size_t records = 0;
+    };
+    struct RatedBatch {
+        vector<Customer*> customers;
+        vector<CallRecord> calls;
+    };
+
+    SubscriberStore& store;
+    BoundedQueue<RawBatch> freeBuffers{kBuffers};
+    BoundedQueue<RawBatch> raw{kBuffers};
+    BoundedQueue<RatedBatch> rated{4};
+    IngestStats stats;          // written by the rating and charging stages
+    bool truncatedTail = false; // written by the reader
+
+    // read() until the buffer is full or the input ends; returns the bytes read.
+    static size_t readFully(int fd, char* dest, size_t size) {
+        size_t done = 0;
+        while (done < size) {
+            const ssize_t n = ::read(fd, dest + done, size - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            done += static_cast<size_t>(n);
+        }
+        return done;
+    }
+
+    void readStage(int fd) {
+        char trailing[sizeof(WireCdr)];
+        size_t carried = 0; // bytes of a record split across two reads
+        while (auto batch = freeBuffers.pop()) {
+            char* data = batch->buffer.data();
+            memcpy(data, trailing, carried);
+            const size_t bytes = carried + readFully(fd, data + carried, batch->buffer.size() - carried);
+            batch->records = bytes / sizeof(WireCdr);
+            carried = bytes % sizeof(WireCdr);
+            memcpy(trailing, data + batch->records * sizeof(WireCdr), carried);
+            if (batch->records == 0) break;
+            raw.push(move(*batch));
+            if (bytes < batch->buffer.size()) break; // end of input
+        }
+        truncatedTail = carried != 0;
+        raw.close();
+    }
+
+    void rateStage() {
+        const size_t operatorCount = store.operatorCount();
+        vector<const Operator*> operators;
+        for (size_t i = 0; i < operatorCount; ++i) operators.push_back(&store.getOperator({static_cast<uint32_t>(i)}));
+        vector<vector<CallRecord>> groups(operatorCount);
+        vector<vector<Customer*>> groupCustomers(operatorCount);
+        while (auto batch = raw.pop()) {
+            for (size_t i = 0; i < operatorCount; ++i) {
+                groups[i].clear();
+                groupCustomers[i].clear();
+            }
+            const char* data = batch->buffer.data();
+            for (size_t r = 0; r < batch->records; ++r) {
+                WireCdr cdr;
+                memcpy(&cdr, data + r * sizeof(WireCdr), sizeof(WireCdr));
+                if (cdr.caller >= store.customerCount() || cdr.callee >= store.customerCount() ||
+                    cdr.kind > static_cast<uint8_t>(CallKind::Network)) {
+                    ++stats.malformed;
+                    continue;
+                }
+                Customer& caller = store.getCustomer({cdr.caller});
+                const Customer& callee = store.getCustomer({cdr.callee});
+                // There are only a handful of operators, a linear scan is cheapest.
+                const size_t op = find(operators.begin(), operators.end(), caller.getOperator()) - operators.begin();
+                groups[op].push_back({static_cast<CallKind>(cdr.kind), cdr.quantity, caller.getAge(),
+                                      callee.getOperator()->getId()});
+                groupCustomers[op].push_back(&caller);
+            }
+            stats.records += batch->records;
+            ++stats.batches;
+            freeBuffers.push(move(*batch));
+
+            RatedBatch out;
+            for (size_t i = 0; i < operatorCount; ++i) {
+                if (groups[i].empty()) continue;
+                store.getOperator({static_cast<uint32_t>(i)}).rateCalls(groups[i]);
+                out.calls.insert(out.calls.end(), groups[i].begin(), groups[i].end());
+                out.customers.insert(out.customers.end(), groupCustomers[i].begin(), groupCustomers[i].end());
+            }
+            rated.push(move(out));
+        }
+        rated.close();
+    }
+
+    void chargeStage() {
+        while (auto batch = rated.pop()) {
+            for (size_t i = 0; i < batch->calls.size(); ++i) {
+                const auto& call = batch->calls[i];
+                if (batch->customers[i]->charge(call.kind, call.cost) == ChargeResult::Charged) ++stats.charged;
+                else ++stats.rejected;
+            }
+        }
+        // Unblock the reader if it is still waiting for a buffer.
+        freeBuffers.close();
+    }
+public:
+    explicit CdrPipeline(SubscriberStore& s) : store(s) {
+        for (size_t i = 0; i < kBuffers; ++i) freeBuffers.push({vector<char>(kBatchRecords * sizeof(WireCdr)), 0});
+    }
+
+    // Reads the stream from fd (a file, pipe or socket) until it ends.
+    IngestStats run(int fd) {
+        char magic[sizeof(kCdrMagic)];
+        if (readFully(fd, magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, kCdrMagic, sizeof(magic)) != 0) {
+            throw runtime_error("Input is not a CDR1 stream");
+        }
+        const auto start = chrono::steady_clock::now();
+        thread reader([&] { readStage(fd); });
+        thread rater([&] { rateStage(); });
+        chargeStage();
+        reader.join();
+        rater.join();
+        stats.malformed += truncatedTail;
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+};
+
+// Synthetic subscribers for the ingest/gen-cdr modes: two operators, customers alternate
+// between them and get ages 10..89.
+void populateSyntheticStore(SubscriberStore& store, size_t customers) {
+    auto op0 = store.addOperator(0, 0.5, 0.2, 0.1, 10);
+    auto op1 = store.addOperator(1, 0.6, 0.25, 0.15, 15);
+    for (size_t i = 0; i < customers; ++i) {
+        store.addCustomer(static_cast<int>(i), "subscriber", 10 + static_cast<int>(i % 80), i % 2 ? op1 : op0, 1e6);
+    }
+}
+
+void writeSyntheticCdrs(const string& path, size_t count, size_t customers) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) throw runtime_error("Cannot open '" + path + "' for writing");
+    fwrite(kCdrMagic, 1, sizeof(kCdrMagic), f);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    vector<WireCdr> chunk;
+    for (size_t i = 0; i < count; ++i) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        WireCdr cdr{};
+        cdr.caller = static_cast<uint32_t>(x % customers);
+        cdr.callee = static_cast<uint32_t>((x >> 20) % customers);
+        cdr.kind = static_cast<uint8_t>((x >> 40) % 3);
+        cdr.quantity = static_cast<float>(1 + (x >> 44) % 30);
+        chunk.push_back(cdr);
+        if (chunk.size() == 65536 || i + 1 == count) {
+            fwrite(chunk.data(), sizeof(WireCdr), chunk.size(), f);
+            chunk.clear();
+        }
+    }
+    fclose(f);
+}
+
+// ---- Sharded billing ----
+//
+// Customers are partitioned by ID over shards (customer i lives in shard i % N at local
+// index i / N), and each shard is served by one worker thread. Only that thread touches
+// the shard's customers and bills, so bill cache lines never move between cores.
+// Every shard has its own copy of the operator tariffs. The only cross-shard lookup,
+// the callee's operator for the same-operator message discount, goes through
+// OperatorDirectory: a plain array that is written during setup and only read after,
+// so its cache lines stay shared and never bounce.
+class OperatorDirectory {
+private:
+    vector<uint16_t> operatorOf; // customer ID -> operator ID
+public:
+    void set(size_t customerId, int operatorId) {
+        if (customerId >= operatorOf.size()) operatorOf.resize(customerId + 1);
+        operatorOf[customerId] = static_cast<uint16_t>(operatorId);
+    }
+    int get(size_t customerId) const { return operatorOf[customerId]; }
+    size_t size() const { return operatorOf.size(); }
+};
+
+struct ShardStats {
+    uint64_t records = 0;
+    uint64_t charged = 0;
+    uint64_t rejected = 0;
+    uint64_t malformed = 0;
+    double busySeconds = 0; // time spent rating and charging, excluding waits on the inbox
+};
+
+class ShardedBilling {
+private:
+    struct alignas(64) Shard {
+        size_t index;
+        SubscriberStore store;
+        vector<OperatorHandle> operators;
+        BoundedQueue<vector<WireCdr>> inbox{8};
+        ShardStats stats;
+        thread worker;
+    };
+
+    vector<unique_ptr<Shard>> shards;
+    OperatorDirectory directory;
+    bool started = false;
+
+    void serve(Shard& shard) {
+        const size_t n = shards.size();
+        const size_t operatorCount = shard.operators.size();
+        vector<const Operator*> operators;
+        for (auto h : shard.operators) operators.push_back(&shard.store.getOperator(h));
+        vector<vector<CallRecord>> groups(operatorCount);
+        vector<vector<Customer*>> groupCustomers(operatorCount);
+        while (auto batch = shard.inbox.pop()) {
+            const auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < operatorCount; ++i) {
+                groups[i].clear();
+                groupCustomers[i].clear();
+            }
+            for (const WireCdr& cdr : *batch) {
+                const size_t local = cdr.caller / n;
+                if (cdr.caller % n != shard.index || local >= shard.store.customerCount() || cdr.callee >= directory.size() ||
+                    cdr.kind > static_cast<uint8_t>(CallKind::Network)) {
+                    ++shard.stats.malformed;
+                    continue;
+                }
+                Customer& caller = shard.store.getCustomer({static_cast<uint32_t>(local)});
+                const size_t op = find(operators.begin(), operators.end(), caller.getOperator()) - operators.begin();
+                groups[op].push_back({static_cast<CallKind>(cdr.kind), cdr.quantity, caller.getAge(),
+                                      directory.get(cdr.callee)});
+                groupCustomers[op].push_back(&caller);
+            }
+            for (size_t i = 0; i < operatorCount; ++i) {
+                shard.store.getOperator(shard.operators[i]).rateCalls(groups[i]);
+                for (size_t j = 0; j < groups[i].size(); ++j) {
+                    const CallRecord& call = groups[i][j];
+                    if (groupCustomers[i][j]->charge(call.kind, call.cost) == ChargeResult::Charged) ++shard.stats.charged;
+                    else ++shard.stats.rejected;
+                }
+            }
+            shard.stats.records += batch->size();
+            shard.stats.busySeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+    }
+public:
+    explicit ShardedBilling(size_t shardCount) {
+        for (size_t i = 0; i < max<size_t>(1, shardCount); ++i) {
+            shards.push_back(make_unique<Shard>());
+            shards.back()->index = i;
+        }
+    }
+
+    ~ShardedBilling() { finish(); }
+
+    // Operators and customers must be added before start().
+    void addOperator(int ID, double talk, double msg, double net, int discount) {
+        for (auto& shard : shards) shard->operators.push_back(shard->store.addOperator(ID, talk, msg, net, discount));
+    }
+
+    // Customer IDs must be consecutive from 0; operatorIndex is the order of addOperator calls.
+    void addCustomer(int ID, string_view name, int age, size_t operatorIndex, double limit) {
+        Shard& shard = *shards[ID % shards.size()];
+        OperatorHandle op = shard.operators[operatorIndex];
+        shard.store.addCustomer(ID, name, age, op, limit);
+        directory.set(ID, shard.store.getOperator(op).getId());
+    }
+
+    void start() {
+        started = true;
+        for (auto& shard : shards) shard->worker = thread([this, s = shard.get()] { serve(*s); });
+    }
+
+    size_t shardCount() const { return shards.size(); }
+    size_t shardOf(uint32_t customerId) const { return customerId % shards.size(); }
+
+    // Hands a batch whose callers all live in `shard` to its worker; blocks while the
+    // shard's inbox is full.
+    void submit(size_t shard, vector<WireCdr> batch) { shards[shard]->inbox.push(move(batch)); }
+
+    // Splits a mixed batch by the caller's shard.
+    void route(span<const WireCdr> cdrs) {
+        vector<vector<WireCdr>> parts(shards.size());
+        for (const WireCdr& cdr : cdrs) parts[shardOf(cdr.caller)].push_back(cdr);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (!parts[i].empty()) submit(i, move(parts[i]));
+        }
+    }
+
+    // Waits for all submitted batches to be processed and stops the workers.
+    void finish() {
+        if (!started) return;
+        for (auto& shard : shards) shard->inbox.close();
+        for (auto& shard : shards) shard->worker.join();
+        started = false;
+    }
+
+    const ShardStats& stats(size_t shard) const { return shards[shard]->stats; }
+};
+
+// Scaling of sharded billing from 1 to hardware_concurrency shards. The input is
+// partitioned by shard up front (as separate ingest connections would deliver it),
+// so the numbers measure rating and charging only. Run: ./main bench-shards [records]
+void runShardScalingBenchmark(size_t records, size_t customers) {
+    const unsigned maxShards = max(1u, thread::hardware_concurrency());
+    vector<unsigned> shardCounts;
+    for (unsigned n = 1; n < maxShards; n *= 2) shardCounts.push_back(n);
+    shardCounts.push_back(maxShards);
+
+    cout << "shards,records_per_sec,min_shard_records_per_sec,max_shard_records_per_sec\n";
+    for (unsigned n : shardCounts) {
+        ShardedBilling billing(n);
+        billing.addOperator(0, 0.5, 0.2, 0.1, 10);
+        billing.addOperator(1, 0.6, 0.25, 0.15, 15);
+        for (size_t i = 0; i < customers; ++i) {
+            billing.addCustomer(static_cast<int>(i), "subscriber", 10 + static_cast<int>(i % 80), i % 2, 1e9);
+        }
+
+        vector<vector<vector<WireCdr>>> input(n);
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (size_t i = 0; i < records; i += CdrPipeline::kBatchRecords) {
+            vector<vector<WireCdr>> parts(n);
+            for (size_t j = i; j < min(records, i + CdrPipeline::kBatchRecords); ++j) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                WireCdr cdr{};
+                cdr.caller = static_cast<uint32_t>(x % customers);
+                cdr.callee = static_cast<uint32_t>((x >> 20) % customers);
+                cdr.kind = static_cast<uint8_t>((x >> 40) % 3);
+                cdr.quantity = static_cast<float>(1 + (x >> 44) % 30);
+                parts[billing.shardOf(cdr.caller)].push_back(cdr);
+            }
+            for (unsigned s = 0; s < n; ++s) input[s].push_back(move(parts[s]));
+        }
+
+        const auto start = chrono::steady_clock::now();
+        billing.start();
+        vector<thread> feeders;
+        for (unsigned s = 0; s < n; ++s) {
+            feeders.emplace_back([&, s] {
+                for (auto& batch : input[s]) billing.submit(s, move(batch));
+            });
+        }
+        for (auto& f : feeders) f.join();
+        billing.finish();
+        const double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        double minRate = 1e300, maxRate = 0;
+        for (unsigned s = 0; s < n; ++s) {
+            const ShardStats& st = billing.stats(s);
+            const double rate = st.records / max(st.busySeconds, 1e-9);
+            minRate = min(minRate, rate);
+            maxRate = max(maxRate, rate);
+        }
+        cout << n << "," << static_cast<int64_t>(records / secs) << "," << static_cast<int64_t>(minRate) << ","
+             << static_cast<int64_t>(maxRate) << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t kSyntheticCustomers = 100000;
+    if (argc > 1 && string(argv[1]) == "bench-shards") {
+        runShardScalingBenchmark(argc > 2 ? stoull(argv[2]) : 20000000, kSyntheticCustomers);
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "gen-cdr") {
+        // ./main gen-cdr <path> [records]
+        const size_t count = argc > 3 ? stoull(argv[3]) : 10000000;
+        writeSyntheticCdrs(argv[2], count, kSyntheticCustomers);
+        cout << "Wrote " << count << " records to " << argv[2] << "\n";
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "ingest") {
+        // ./main ingest <path>, or "-" for stdin (e.g. nc -l 9000 | ./main ingest -)
+        const string path = argv[2];
+        const int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            cerr << "Cannot open '" << path << "'\n";
+            return 1;
+        }
+        SubscriberStore store;
+        populateSyntheticStore(store, kSyntheticCustomers);
+        CdrPipeline pipeline(store);
+        IngestStats stats;
+        try {
+            stats = pipeline.run(fd);
+        } catch (const exception& e) {
+            cerr << e.what() << "\n";
+            return 1;
+        }
+        if (fd != STDIN_FILENO) close(fd);
+        cout << stats.records << " records in " << stats.batches << " batches, " << fixed << setprecision(3)
+             << stats.seconds << " s (" << setprecision(0) << stats.records / stats.seconds << " records/s)\n"
+             << "charged " << stats.charged << ", rejected " << stats.rejected << ", malformed " << stats.malformed
+             << "\n";
+        return 0;
+    }
+
+    // Rejections are printed by the sink's drain thread, not by the charging code.
+    RejectionSink rejections([](const RejectionEvent& e) {
+        static const char* messages[] = {"Talk not allowed", "Message not sent", "Connection denied"};
+        cout << "Limit exceeded. " << messages[static_cast<size_t>(e.kind)] << ".\n";
+    });
+    SubscriberStore store;
+    vector<Operator*> operators;
+    vector<Customer*> customers;
+
+    auto op0 = store.addOperator(0, 0.5, 0.2, 0.1, 10);
+    auto op1 = store.addOperator(1, 0.6, 0.25, 0.15, 15);
+    operators.push_back(&store.getOperator(op0));
+    operators.push_back(&store.getOperator(op1));
+    for (auto* op : operators) op->setRejectionSink(&rejections);
+
+    customers.push_back(&store.getCustomer(store.addCustomer(0, "Alice", 20, op0, 100.0)));
+    customers.push_back(&store.getCustomer(store.addCustomer(1, "Bob", 70, op1, 150.0)));
 
     cout << "=== Initial State ===\n\n";
 
@@ -178,7 +954,42 @@ int main() {
     customers[0]->pay(20);
 
     cout << "[Operation] Alice changes operator to Operator 1.\n";
-    customers[0]->changeOperator(operators[1].get());
+    customers[0]->changeOperator(operators[1]);
+
+    cout << "[Operation] Operator 0 rates a batch of CDRs.\n";
+    vector<CallRecord> cdrs = {
+        {CallKind::Talk, 10, 20, 1},
+        {CallKind::Talk, 3, 70, 0},
+        {CallKind::Message, 5, 30, 0},
+        {CallKind::Message, 5, 30, 1},
+        {CallKind::Network, 50, 16, 0},
+    };
+    operators[0]->rateCalls(cdrs);
+    double batchTotal = 0;
+    for (const auto& r : cdrs) batchTotal += r.cost;
+    cout << "   " << cdrs.size() << " records, total cost " << fixed << setprecision(2) << batchTotal << "\n";
+
+    cout << "[Operation] 4 threads charge Bob's bill 1.00 at a time until the limit.\n";
+    atomic<int> accepted{0};
+    vector<thread> chargers;
+    for (int t = 0; t < 4; ++t) {
+        chargers.emplace_back([&] {
+            while (customers[1]->getBill()->tryCharge(1.0)) ++accepted;
+        });
+    }
+    for (auto& th : chargers) th.join();
+    cout << "   " << accepted << " charges accepted, debt " << customers[1]->getBill()->getCurrentDebt()
+         << " of limit " << customers[1]->getBill()->getLimitingAmount() << "\n";
+
+    cout << "[Operation] Bob tries to talk for 10 more minutes.\n";
+    if (customers[1]->talk(10, *customers[0]) == ChargeResult::LimitExceeded) {
+        cout << "   rejected\n";
+    }
+    rejections.stop();
+    cout << "   rejections: talk=" << rejections.rejections(CallKind::Talk)
+         << " message=" << rejections.rejections(CallKind::Message)
+         << " network=" << rejections.rejections(CallKind::Network)
+         << " | operator 1: " << rejections.rejectionsForOperator(1) << "\n";
 
     cout << "\n=== Final State ===\n\n";
 
@@ -3,6 +3,22 @@
 #include <cmath>
 #include <algorithm>
 #include <iomanip>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <limits>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <numeric>
+#include <new>
+#include <memory>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+#include "../../common/instrument.h"
 using namespace std;
 
 // Forward declarations
@@ -25,58 +41,178 @@ public:
     virtual ~IShip() {}
 };
 
+// Type tag stored in every container, so hot paths can branch on the kind without
+// a virtual call or a string comparison. type() stays for printing.
+enum class ContainerKind : uint8_t { Basic, Heavy, Refrigerated, Liquid };
+constexpr size_t kContainerKinds = 4;
+
 class Container {
 protected:
     int ID;
     int weight;
+    ContainerKind tag;
+    double value; // cargo value used by Ship::planLoad; defaults to the weight
+    size_t holdSlot = SIZE_MAX; // index in the holding ship's list of containers
+    friend class Ship;
 public:
-    Container(int id, int w) : ID(id), weight(w) {}
+    Container(int id, int w, ContainerKind k) : ID(id), weight(w), tag(k), value(w) {}
     virtual double consumption() const = 0;
     int getID() const { return ID; }
     int getWeight() const { return weight; }
+    ContainerKind kind() const { return tag; }
+    double getValue() const { return value; }
+    void setValue(double v) { value = v; }
 
     virtual string type() const = 0;
 
     bool equals(const Container& other) const {
-        return (ID == other.ID && weight == other.weight && type() == other.type());
+        return (ID == other.ID && weight == other.weight && tag == other.tag);
     }
     virtual ~Container() {}
 };
 
 class BasicContainer : public Container {
 public:
-    BasicContainer(int id, int w) : Container(id, w) {}
+    BasicContainer(int id, int w) : Container(id, w, ContainerKind::Basic) {}
     double consumption() const override { return 2.5; }  // per unit weight
     string type() const override { return "Basic"; }
 };
 
 class HeavyContainer : public Container {
 public:
-    HeavyContainer(int id, int w) : Container(id, w) {}
+    HeavyContainer(int id, int w) : Container(id, w, ContainerKind::Heavy) {}
     double consumption() const override { return 3.0; }
     string type() const override { return "Heavy"; }
+protected:
+    HeavyContainer(int id, int w, ContainerKind k) : Container(id, w, k) {}
 };
 
 class RefrigeratedContainer : public HeavyContainer {
 public:
-    RefrigeratedContainer(int id, int w) : HeavyContainer(id, w) {}
+    RefrigeratedContainer(int id, int w) : HeavyContainer(id, w, ContainerKind::Refrigerated) {}
     double consumption() const override { return 5.0; }
     string type() const override { return "Refrigerated"; }
 };
 
 class LiquidContainer : public HeavyContainer {
 public:
-    LiquidContainer(int id, int w) : HeavyContainer(id, w) {}
+    LiquidContainer(int id, int w) : HeavyContainer(id, w, ContainerKind::Liquid) {}
     double consumption() const override { return 4.0; }
     string type() const override { return "Liquid"; }
 };
 
+// Port storage for containers. Containers are kept in one bucket per kind, and a
+// hash from container ID to (kind, position) finds any of them in O(1). Removal moves
+// the bucket's last element into the freed slot (swap-and-pop), so order within a
+// bucket is not preserved.
+class ContainerInventory {
+private:
+    struct Slot {
+        ContainerKind kind;
+        size_t index;
+    };
+
+    array<vector<Container*>, kContainerKinds> buckets;
+    unordered_multimap<int, Slot> slots; // ID -> slot; IDs may repeat with different weight/kind
+    size_t count = 0;
+
+    vector<Container*>& bucketOf(ContainerKind k) { return buckets[static_cast<size_t>(k)]; }
+
+    // Finds the slots entry that points at (kind, index).
+    unordered_multimap<int, Slot>::iterator entryFor(int id, ContainerKind kind, size_t index) {
+        auto range = slots.equal_range(id);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.kind == kind && it->second.index == index) return it;
+        }
+        return slots.end();
+    }
+public:
+    void add(Container* c) {
+        auto& bucket = bucketOf(c->kind());
+        slots.emplace(c->getID(), Slot{c->kind(), bucket.size()});
+        bucket.push_back(c);
+        ++count;
+    }
+
+    template <typename It>
+    void addRange(It first, It last) {
+        // reserve() always rehashes in libstdc++, so only grow when the range would not fit.
+        const size_t needed = slots.size() + static_cast<size_t>(distance(first, last));
+        if (needed > slots.bucket_count() * slots.max_load_factor()) slots.reserve(needed);
+        for (; first != last; ++first) add(*first);
+    }
+
+    // Removes and returns the stored container equal to c, or nullptr.
+    Container* take(const Container& c) {
+        auto range = slots.equal_range(c.getID());
+        for (auto it = range.first; it != range.second; ++it) {
+            auto& bucket = bucketOf(it->second.kind);
+            const size_t index = it->second.index;
+            Container* found = bucket[index];
+            if (!found->equals(c)) continue;
+
+            slots.erase(it);
+            if (index + 1 != bucket.size()) {
+                Container* moved = bucket.back();
+                entryFor(moved->getID(), moved->kind(), bucket.size() - 1)->second.index = index;
+                bucket[index] = moved;
+            }
+            bucket.pop_back();
+            --count;
+            return found;
+        }
+        return nullptr;
+    }
+
+    const vector<Container*>& ofKind(ContainerKind k) const { return buckets[static_cast<size_t>(k)]; }
+    size_t size() const { return count; }
+
+    template <typename F>
+    void forEach(F f) const {
+        for (const auto& bucket : buckets)
+            for (Container* c : bucket) f(c);
+    }
+};
+
+// Append-only log of arrivals and departures at one port. Entries are 16 bytes and
+// their times never decrease, so a time range is found by binary search.
+struct PortVisit {
+    enum Kind : uint8_t { Arrival, Departure };
+    double time;
+    int32_t shipId;
+    Kind kind;
+};
+
+class VisitLog {
+private:
+    vector<PortVisit> entries;
+public:
+    void append(double time, int shipId, PortVisit::Kind kind) {
+        if (!entries.empty()) time = max(time, entries.back().time); // keep the log sorted
+        entries.push_back({time, shipId, kind});
+    }
+
+    // Entries with from <= time < to, as a [first, last) range into the log.
+    pair<const PortVisit*, const PortVisit*> between(double from, double to) const {
+        auto cmp = [](const PortVisit& v, double t) { return v.time < t; };
+        const PortVisit* begin = entries.data();
+        const PortVisit* end = begin + entries.size();
+        const PortVisit* first = lower_bound(begin, end, from, cmp);
+        const PortVisit* last = lower_bound(first, end, to, cmp);
+        return {first, last};
+    }
+
+    size_t size() const { return entries.size(); }
+    const vector<PortVisit>& all() const { return entries; }
+};
+
 class Port : public IPort {
     int ID;
     double latitude, longitude;
-    vector<Container*> containers;
-    vector<Ship*> history;
-    vector<Ship*> current;
+    ContainerInventory containers;
+    VisitLog history;
+    vector<Ship*> current; // each ship stores its own index here (Ship::berth)
+    double clock = 0;      // time stamp for the visit log, set by the caller
 public:
     Port(int id, double lat, double lon) : ID(id), latitude(lat), longitude(lon) {}
 
@@ -90,42 +226,196 @@ public:
         return sqrt(dx*dx + dy*dy);
     }
 
-    Container* getContainer(Container* c) {
-    auto it = std::find_if(containers.begin(), containers.end(),
-        [&](Container* x){ return x->equals(*c); });
-    if (it == containers.end()) return nullptr;
-    Container* found = *it;
-    containers.erase(it);
-    return found;
-}
+    Container* getContainer(Container* c) { return containers.take(*c); }
 
-    void addContainer(Container* c) { containers.push_back(c); }
+    void addContainer(Container* c) { containers.add(c); }
 
-    void incomingShip(Ship* s) override {
-        if (find(current.begin(), current.end(), s) == current.end())
-            current.push_back(s);
-        if (find(history.begin(), history.end(), s) == history.end())
-            history.push_back(s);
-    }
+    // O(1): the ship remembers its slot in `current`, departures swap-and-pop.
+    void incomingShip(Ship* s) override;
+    void outgoingShip(Ship* s) override;
 
-    void outgoingShip(Ship* s) override {
-        current.erase(remove(current.begin(), current.end(), s), current.end());
-    }
+    void setClock(double t) { clock = t; }
+    const VisitLog& getHistory() const { return history; }
+    size_t shipCount() const { return current.size(); }
 
-    void getContainersFromShip(vector<Container*> incomingContainers) {
-        this->containers.insert(this->containers.end(), incomingContainers.begin(), incomingContainers.end());
+    void getContainersFromShip(const vector<Container*>& incomingContainers) {
+        containers.addRange(incomingContainers.begin(), incomingContainers.end());
     }
 
-    void printState() const {
-        cout << "Port " << ID << " (" << latitude << "," << longitude << ")\n";
-        cout << " Containers: ";
-        for (auto c : containers) cout << c->type() << "#" << c->getID() << " ";
-        cout << "\n Ships: ";
-        for (auto s : current) cout << "Ship#" << s << " "; // pointer IDs for now
-        cout << "\n";
-    }
+    const ContainerInventory& getInventory() const { return containers; }
+
+    void printState() const;
+};
+
+// ---- Load planning ----
+
+struct LoadPlanOptions {
+    const Port* destination = nullptr; // if set, the fuel for the trip is priced and must fit in the tank
+    double fuelPrice = 1.0;            // value units per unit of fuel
+    chrono::milliseconds timeBudget{50};
+    unsigned threads = 0;              // 0 = hardware_concurrency
+};
+
+struct LoadPlan {
+    vector<Container*> containers;
+    int weight = 0;
+    double value = 0;
+    double fuelCost = 0; // extra fuel cost of carrying the chosen containers
+    double score() const { return value - fuelCost; }
 };
 
+// Multi-dimensional 0/1 knapsack: maximize sum(score) subject to the weight,
+// container-count, per-kind and consumption limits. When only a few items are worth
+// loading, every subset is tried. Otherwise it is solved with a randomized greedy +
+// swap local search; each thread restarts with different weights on the limits until
+// the time budget runs out or kStaleRestarts restarts in a row bring no improvement,
+// and the best plan wins.
+struct LoadProblem {
+    struct Item {
+        Container* container;
+        int weight;
+        int kind;         // ContainerKind index
+        double consumption;
+        double score;     // value - fuelPrice * distance * consumption
+    };
+
+    vector<Item> items;
+    int weightLeft;
+    int countLeft;
+    array<int, kContainerKinds> kindLeft; // numeric_limits<int>::max() for unlimited kinds
+    double consumptionLeft;               // infinity when no destination is given
+};
+
+constexpr size_t kExactLoadItems = 16;
+constexpr unsigned kStaleRestarts = 8;
+
+inline vector<size_t> solveLoadProblem(const LoadProblem& problem, const LoadPlanOptions& options) {
+    const size_t n = problem.items.size();
+    if (n == 0 || problem.countLeft <= 0) return {};
+
+    struct Usage {
+        long long weight = 0;
+        int count = 0;
+        array<int, kContainerKinds> kinds{};
+        double consumption = 0;
+    };
+    auto fits = [&](const Usage& u, const LoadProblem::Item& it) {
+        return u.weight + it.weight <= problem.weightLeft && u.count + 1 <= problem.countLeft &&
+               u.kinds[it.kind] + 1 <= problem.kindLeft[it.kind] &&
+               u.consumption + it.consumption <= problem.consumptionLeft + 1e-9;
+    };
+    auto add = [&](Usage& u, const LoadProblem::Item& it, int sign) {
+        u.weight += sign * it.weight;
+        u.count += sign;
+        u.kinds[it.kind] += sign;
+        u.consumption += sign * it.consumption;
+    };
+
+    vector<size_t> useful; // items with a positive score; no optimal plan carries the others
+    for (size_t i = 0; i < n; ++i) if (problem.items[i].score > 0) useful.push_back(i);
+    if (useful.size() <= kExactLoadItems) {
+        uint32_t bestMask = 0;
+        double bestExact = 0;
+        for (uint32_t mask = 1; mask < (1u << useful.size()); ++mask) {
+            Usage usage;
+            double score = 0;
+            bool ok = true;
+            for (size_t j = 0; j < useful.size() && ok; ++j) {
+                if (!(mask >> j & 1)) continue;
+                const auto& it = problem.items[useful[j]];
+                ok = fits(usage, it);
+                add(usage, it, +1);
+                score += it.score;
+            }
+            if (ok && score > bestExact) {
+                bestExact = score;
+                bestMask = mask;
+            }
+        }
+        vector<size_t> result;
+        for (size_t j = 0; j < useful.size(); ++j) if (bestMask >> j & 1) result.push_back(useful[j]);
+        return result;
+    }
+
+    const auto deadline = chrono::steady_clock::now() + options.timeBudget;
+    const unsigned threads = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+    vector<vector<size_t>> best(threads);
+    vector<double> bestScore(threads, -numeric_limits<double>::infinity());
+    auto worker = [&](unsigned t) {
+        mt19937_64 rng(0x9E3779B97F4A7C15ull * (t + 1));
+        uniform_real_distribution<double> jitter(0.5, 1.5);
+        vector<size_t> order(n);
+        vector<double> ratio(n);
+        vector<char> chosen(n);
+        // The first restart of thread 0 uses unit weights, so a zero budget still yields a plan.
+        unsigned stale = 0;
+        for (bool first = true; first || (stale < kStaleRestarts && chrono::steady_clock::now() < deadline); first = false) {
+            const double a = first && t == 0 ? 1 : jitter(rng), b = first && t == 0 ? 1 : jitter(rng);
+            const double c = first && t == 0 ? 1 : jitter(rng), d = first && t == 0 ? 1 : jitter(rng);
+            for (size_t i = 0; i < n; ++i) {
+                const auto& it = problem.items[i];
+                double cost = a * it.weight / max(1, problem.weightLeft) + b / problem.countLeft;
+                if (problem.kindLeft[it.kind] != numeric_limits<int>::max()) cost += c / max(1, problem.kindLeft[it.kind]);
+                if (problem.consumptionLeft != numeric_limits<double>::infinity())
+                    cost += d * it.consumption / max(1e-9, problem.consumptionLeft);
+                ratio[i] = it.score / cost;
+            }
+            iota(order.begin(), order.end(), 0);
+            sort(order.begin(), order.end(), [&](size_t x, size_t y) { return ratio[x] > ratio[y]; });
+
+            Usage usage;
+            fill(chosen.begin(), chosen.end(), 0);
+            vector<size_t> selected;
+            double score = 0;
+            for (size_t i : order) {
+                if (problem.items[i].score <= 0) break;
+                if (!fits(usage, problem.items[i])) continue;
+                add(usage, problem.items[i], +1);
+                chosen[i] = 1;
+                selected.push_back(i);
+                score += problem.items[i].score;
+            }
+
+            // Swap pass: replace one of the lowest-scoring chosen items with a better unchosen one.
+            sort(selected.begin(), selected.end(),
+                 [&](size_t x, size_t y) { return problem.items[x].score < problem.items[y].score; });
+            const size_t window = min<size_t>(selected.size(), 64);
+            for (size_t k = 0; k < n && chrono::steady_clock::now() < deadline; ++k) {
+                const size_t u = order[k];
+                if (chosen[u] || problem.items[u].score <= 0) continue;
+                for (size_t j = 0; j < window; ++j) {
+                    const size_t out = selected[j];
+                    if (!chosen[out] || problem.items[out].score >= problem.items[u].score) continue;
+                    add(usage, problem.items[out], -1);
+                    if (fits(usage, problem.items[u])) {
+                        add(usage, problem.items[u], +1);
+                        chosen[out] = 0;
+                        chosen[u] = 1;
+                        score += problem.items[u].score - problem.items[out].score;
+                        selected[j] = u;
+                        break;
+                    }
+                    add(usage, problem.items[out], +1);
+                }
+            }
+            if (score > bestScore[t]) {
+                bestScore[t] = score;
+                best[t].clear();
+                for (size_t i = 0; i < n; ++i) if (chosen[i]) best[t].push_back(i);
+                stale = 0;
+            } else {
+                ++stale;
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : pool) th.join();
+    return best[max_element(bestScore.begin(), bestScore.end()) - bestScore.begin()];
+}
+
 class Ship : public IShip {
     int ID;
     double fuel;
@@ -136,7 +426,14 @@ class Ship : public IShip {
     int maxRefrig;
     int maxLiquid;
     double fuelPerKm;
+    Port* destination = nullptr; // set between depart() and arrive()
+    size_t berth = SIZE_MAX;     // index in currentPort's list of ships
+    friend class Port;
     vector<Container*> containers;
+    // Running totals over `containers`, kept in step by load/unLoad.
+    int loadedWeight = 0;
+    double loadedConsumption = 0;
+    array<int, kContainerKinds> loadedByKind{};
 public:
     Ship(int id, Port* port, int totalW, int all, int heavy, int refrig, int liquid, double fpkm)
         : ID(id), fuel(0), currentPort(port), totalWeightCapacity(totalW),
@@ -147,56 +444,153 @@ public:
     }
 
     bool sailTo(Port* p) override {
-        if (!p) return false;
-        double dist = currentPort->getDistance(*p);
-        double required = dist * (fuelPerKm + totalContainerConsumption());
+        INSTR_SPAN("lab2.Ship::sailTo");
+        if (!depart(p)) {
+            INSTR_COUNT("lab2.Ship::sailTo.refused");
+            return false;
+        }
+        arrive();
+        return true;
+    }
+
+    // sailTo() in two steps, for callers that model the time at sea: depart() burns
+    // the fuel and leaves the current port, arrive() docks at the destination.
+    bool depart(Port* p) {
+        if (!p || !currentPort || destination) return false;
+        const double required = fuelFor(*p);
         if (fuel >= required) {
             fuel -= required;
             currentPort->outgoingShip(this);
-            currentPort = p;
-            p->incomingShip(this); 
+            currentPort = nullptr;
+            destination = p;
             return true;
         }
         return false;
     }
 
+    void arrive() {
+        if (!destination) return;
+        currentPort = destination;
+        destination = nullptr;
+        currentPort->incomingShip(this);
+    }
+
     void reFuel(double newFuel) override {
         fuel += newFuel;
     }
 
     bool load(Container* c) override {
+        INSTR_SPAN("lab2.Ship::load");
         if ((int)containers.size() >= maxAll) return false;
-        int totalW = 0;
-        for (auto x : containers) totalW += x->getWeight();
-        if (totalW + c->getWeight() > totalWeightCapacity) return false;
+        if (c->holdSlot != SIZE_MAX) return false; // already in a hold
+        if (loadedWeight + c->getWeight() > totalWeightCapacity) return false;
 
-        if (c->type() == "Heavy" && countType("Heavy") >= maxHeavy) return false;
-        if (c->type() == "Refrigerated" && countType("Refrigerated") >= maxRefrig) return false;
-        if (c->type() == "Liquid" && countType("Liquid") >= maxLiquid) return false;
+        const ContainerKind k = c->kind();
+        if (k == ContainerKind::Heavy && countType(k) >= maxHeavy) return false;
+        if (k == ContainerKind::Refrigerated && countType(k) >= maxRefrig) return false;
+        if (k == ContainerKind::Liquid && countType(k) >= maxLiquid) return false;
 
+        c->holdSlot = containers.size();
         containers.push_back(c);
+        loadedWeight += c->getWeight();
+        loadedConsumption += c->consumption();
+        ++loadedByKind[static_cast<size_t>(k)];
+        INSTR_COUNT("lab2.Ship::load.loaded");
         return true;
     }
 
+    // Swap-and-pop like ContainerInventory::take, so the hold order is not preserved.
     bool unLoad(Container* c) override {
-        auto it = find(containers.begin(), containers.end(), c);
-        if (it == containers.end()) return false;
-        containers.erase(it);
+        const size_t index = c->holdSlot;
+        if (index >= containers.size() || containers[index] != c) return false;
+        if (index + 1 != containers.size()) {
+            Container* moved = containers.back();
+            moved->holdSlot = index;
+            containers[index] = moved;
+        }
+        containers.pop_back();
+        c->holdSlot = SIZE_MAX;
+        loadedWeight -= c->getWeight();
+        loadedConsumption -= c->consumption();
+        --loadedByKind[static_cast<size_t>(c->kind())];
+        if (containers.empty()) loadedConsumption = 0; // drop accumulated rounding error
         if (currentPort) currentPort->addContainer(c);
         return true;
     }
 
+    // Picks containers from `from` to add to the current hold. The plan respects the
+    // remaining weight/count/kind limits and, with a destination, the fuel in the tank;
+    // it maximizes cargo value minus the price of the extra fuel the cargo burns.
+    // Nothing is loaded; use applyPlan() for that.
+    LoadPlan planLoad(const Port& from, const LoadPlanOptions& options = {}) const {
+        const double distance = options.destination && currentPort ? currentPort->getDistance(*options.destination) : 0;
+        LoadProblem problem;
+        problem.weightLeft = totalWeightCapacity - loadedWeight;
+        problem.countLeft = maxAll - static_cast<int>(containers.size());
+        problem.kindLeft = {numeric_limits<int>::max(), maxHeavy - countType(ContainerKind::Heavy),
+                            maxRefrig - countType(ContainerKind::Refrigerated),
+                            maxLiquid - countType(ContainerKind::Liquid)};
+        problem.consumptionLeft = distance > 0 ? fuel / distance - fuelPerKm - loadedConsumption
+                                               : numeric_limits<double>::infinity();
+        from.getInventory().forEach([&](Container* c) {
+            const double cons = c->consumption();
+            problem.items.push_back({c, c->getWeight(), static_cast<int>(c->kind()), cons,
+                                     c->getValue() - options.fuelPrice * distance * cons});
+        });
+
+        LoadPlan plan;
+        for (size_t i : solveLoadProblem(problem, options)) {
+            const auto& item = problem.items[i];
+            plan.containers.push_back(item.container);
+            plan.weight += item.weight;
+            plan.value += item.container->getValue();
+            plan.fuelCost += options.fuelPrice * distance * item.consumption;
+        }
+        return plan;
+    }
+
+    // Takes the planned containers from the port and loads them; returns how many were loaded.
+    int applyPlan(Port& from, const LoadPlan& plan) {
+        int loaded = 0;
+        for (Container* c : plan.containers) {
+            Container* taken = from.getContainer(c);
+            if (!taken) continue;
+            if (load(taken)) ++loaded;
+            else from.addContainer(taken);
+        }
+        return loaded;
+    }
+
+    // Moves the whole hold to the current port in one bulk transfer.
+    int unLoadAll() {
+        if (!currentPort) return 0;
+        vector<Container*> hold;
+        hold.swap(containers);
+        for (Container* c : hold) c->holdSlot = SIZE_MAX;
+        loadedWeight = 0;
+        loadedConsumption = 0;
+        loadedByKind.fill(0);
+        currentPort->getContainersFromShip(hold);
+        return static_cast<int>(hold.size());
+    }
+
     vector<Container*> getCurrentContainers() {
         sort(containers.begin(), containers.end(),
             [](Container* a, Container* b){ return a->getID() < b->getID(); });
+        for (size_t i = 0; i < containers.size(); ++i) containers[i]->holdSlot = i;
         return containers;
     }
 
-    double totalContainerConsumption() const {
-        double sum = 0;
-        for (auto c : containers) sum += c->consumption();
-        return sum;
-    }
+    double totalContainerConsumption() const { return loadedConsumption; }
+    int totalContainerWeight() const { return loadedWeight; }
+
+    int getID() const { return ID; }
+    double getFuel() const { return fuel; }
+    Port* getCurrentPort() const { return currentPort; }
+    // Fuel burned per unit of distance with the current hold.
+    double fuelRate() const { return fuelPerKm + totalContainerConsumption(); }
+    // Fuel depart(&p) needs from the current port; callers buying fuel should use this exact value.
+    double fuelFor(const Port& p) const { return currentPort ? currentPort->getDistance(p) * fuelRate() : 0; }
 
     void printState() const {
         cout << " Ship " << ID << " Fuel=" << fixed << setprecision(2) << fuel << " ";
@@ -205,14 +599,530 @@ public:
         cout << "\n";
     }
 private:
-    int countType(string t) const {
-        int count = 0;
-        for (auto c : containers) if (c->type() == t) count++;
-        return count;
+    int countType(ContainerKind k) const { return loadedByKind[static_cast<size_t>(k)]; }
+};
+
+void Port::incomingShip(Ship* s) {
+    if (s->berth < current.size() && current[s->berth] == s) return;
+    s->berth = current.size();
+    current.push_back(s);
+    history.append(clock, s->getID(), PortVisit::Arrival);
+}
+
+void Port::outgoingShip(Ship* s) {
+    if (s->berth >= current.size() || current[s->berth] != s) return;
+    Ship* last = current.back();
+    current[s->berth] = last;
+    last->berth = s->berth;
+    current.pop_back();
+    s->berth = SIZE_MAX;
+    history.append(clock, s->getID(), PortVisit::Departure);
+}
+
+void Port::printState() const {
+    cout << "Port " << ID << " (" << latitude << "," << longitude << ")\n";
+    cout << " Containers: ";
+    containers.forEach([](Container* c) { cout << c->type() << "#" << c->getID() << " "; });
+    cout << "\n Ships: ";
+    vector<int> ids;
+    for (auto s : current) ids.push_back(s->getID());
+    sort(ids.begin(), ids.end());
+    for (int id : ids) cout << "Ship#" << id << " ";
+    cout << "\n";
+}
+
+// ---- Fleet routing ----
+
+enum class DistanceMetric {
+    Planar,     // same as Port::getDistance, i.e. what Ship::sailTo charges fuel for
+    GreatCircle // haversine over lat/lon in degrees, kilometres
+};
+
+constexpr double kEarthRadiusKm = 6371.0;
+constexpr double kRadPerDegree = 3.14159265358979323846 / 180.0;
+
+// Haversine with latitudes/longitudes already in radians and cos(lat) precomputed.
+inline double greatCircleKm(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2) {
+    const double sLat = sin((lat2 - lat1) / 2), sLon = sin((lon2 - lon1) / 2);
+    const double h = sLat * sLat + cosLat1 * cosLat2 * sLon * sLon;
+    return 2 * kEarthRadiusKm * asin(min(1.0, sqrt(h)));
+}
+
+inline double greatCircleKm(double lat1, double lon1, double lat2, double lon2) {
+    lat1 *= kRadPerDegree; lon1 *= kRadPerDegree; lat2 *= kRadPerDegree; lon2 *= kRadPerDegree;
+    return greatCircleKm(lat1, lon1, cos(lat1), lat2, lon2, cos(lat2));
+}
+
+// All pairwise distances for a fixed set of ports, computed once (in parallel) into one
+// flat row-major array. Rows are padded to whole 64-byte cache lines and the array is
+// 64-byte aligned, so a lookup is a single load and, in shortest-path relaxation, a
+// whole row is read sequentially.
+class DistanceMatrix {
+private:
+    struct AlignedFree {
+        void operator()(double* p) const { ::operator delete[](p, align_val_t(64)); }
+    };
+
+    size_t n = 0;
+    size_t stride = 0; // doubles per row, a multiple of 8
+    unique_ptr<double[], AlignedFree> data;
+public:
+    DistanceMatrix() = default;
+
+    DistanceMatrix(const vector<Port*>& ports, DistanceMetric metric, unsigned threads)
+        : n(ports.size()), stride((ports.size() + 7) / 8 * 8) {
+        const size_t cells = max<size_t>(1, n * stride);
+        data.reset(static_cast<double*>(::operator new[](cells * sizeof(double), align_val_t(64))));
+        fill(data.get(), data.get() + cells, 0.0);
+        vector<double> lat(n), lon(n), cosLat(n);
+        for (size_t i = 0; i < n; ++i) {
+            lat[i] = ports[i]->getLat() * kRadPerDegree;
+            lon[i] = ports[i]->getLon() * kRadPerDegree;
+            cosLat[i] = cos(lat[i]);
+        }
+        // Both metrics are symmetric: each thread fills the upper triangle of its rows
+        // (interleaved, so the triangle is split evenly) and mirrors it.
+        auto rows = [&](size_t from, size_t step) {
+            for (size_t i = from; i < n; i += step) {
+                double* row = data.get() + i * stride;
+                for (size_t j = i + 1; j < n; ++j) {
+                    const double d = metric == DistanceMetric::Planar
+                        ? ports[i]->getDistance(*ports[j])
+                        : greatCircleKm(lat[i], lon[i], cosLat[i], lat[j], lon[j], cosLat[j]);
+                    row[j] = d;
+                    data[j * stride + i] = d;
+                }
+            }
+        };
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(rows, t, threads);
+        rows(0, threads);
+        for (auto& th : pool) th.join();
     }
+
+    double operator()(size_t i, size_t j) const { return data[i * stride + j]; }
+    const double* row(size_t i) const { return data.get() + i * stride; }
+    size_t size() const { return n; }
 };
 
-int main() {
+struct Route {
+    bool reachable = false;
+    vector<Port*> ports; // from the start port to the destination, inclusive
+    double distance = 0;
+    double fuel = 0;     // at the ship's current fuelRate()
+};
+
+struct FleetAssignment {
+    Ship* ship;
+    Port* target;
+    Route route;
+};
+
+// Shortest fuel-feasible routes over a fixed port set. A ship may hop through other
+// ports, refuelling to tankCapacity at each stop: a leg is allowed when its fuel fits
+// in the tank, and the first leg must also fit in the fuel on board now. Fuel burned is
+// proportional to distance (rate fuelPerKm + totalContainerConsumption()), so the
+// shortest path is also the cheapest. Dijkstra runs on the dense matrix (O(n^2),
+// no heap); routes for different ships are computed in parallel.
+class FleetRouter {
+private:
+    vector<Port*> ports;
+    unordered_map<const Port*, size_t> indexOf;
+    DistanceMatrix matrix;
+    unsigned threads;
+
+    Route dijkstra(size_t source, size_t target, double rate, double firstLegFuel, double tankCapacity) const {
+        const size_t n = ports.size();
+        const double maxLeg = rate > 0 ? tankCapacity / rate : numeric_limits<double>::infinity();
+        const double maxFirstLeg = rate > 0 ? min(firstLegFuel, tankCapacity) / rate : numeric_limits<double>::infinity();
+        vector<double> dist(n, numeric_limits<double>::infinity());
+        vector<size_t> prev(n, n);
+        vector<char> done(n, 0);
+        dist[source] = 0;
+        for (size_t step = 0; step < n; ++step) {
+            size_t u = n;
+            for (size_t i = 0; i < n; ++i) {
+                if (!done[i] && (u == n || dist[i] < dist[u])) u = i;
+            }
+            if (u == n || dist[u] == numeric_limits<double>::infinity()) break;
+            if (u == target) break;
+            done[u] = 1;
+            const double* row = matrix.row(u);
+            const double limit = u == source ? maxFirstLeg : maxLeg;
+            for (size_t v = 0; v < n; ++v) {
+                if (done[v] || row[v] > limit) continue;
+                const double d = dist[u] + row[v];
+                if (d < dist[v]) {
+                    dist[v] = d;
+                    prev[v] = u;
+                }
+            }
+        }
+
+        Route route;
+        if (dist[target] == numeric_limits<double>::infinity()) return route;
+        route.reachable = true;
+        route.distance = dist[target];
+        route.fuel = dist[target] * rate;
+        for (size_t v = target; v != n; v = prev[v]) route.ports.push_back(ports[v]);
+        reverse(route.ports.begin(), route.ports.end());
+        return route;
+    }
+
+    template <typename F>
+    void parallelFor(size_t count, F f) const {
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads; ++t) {
+            pool.emplace_back([&, t] { for (size_t i = t; i < count; i += threads) f(i); });
+        }
+        for (size_t i = 0; i < count; i += threads) f(i);
+        for (auto& th : pool) th.join();
+    }
+public:
+    FleetRouter(vector<Port*> portSet, DistanceMetric metric = DistanceMetric::Planar, unsigned threadCount = 0)
+        : ports(move(portSet)), threads(threadCount ? threadCount : max(1u, thread::hardware_concurrency())) {
+        for (size_t i = 0; i < ports.size(); ++i) indexOf[ports[i]] = i;
+        matrix = DistanceMatrix(ports, metric, threads);
+    }
+
+    const DistanceMatrix& distances() const { return matrix; }
+
+    Route route(const Ship& ship, const Port* to, double tankCapacity) const {
+        auto from = indexOf.find(ship.getCurrentPort());
+        auto target = indexOf.find(to);
+        if (from == indexOf.end() || target == indexOf.end()) return {};
+        return dijkstra(from->second, target->second, ship.fuelRate(), ship.getFuel(), tankCapacity);
+    }
+
+    // Routes for every ship to the same destination.
+    vector<Route> routes(const vector<Ship*>& ships, const Port* to, double tankCapacity) const {
+        vector<Route> result(ships.size());
+        parallelFor(ships.size(), [&](size_t i) { result[i] = route(*ships[i], to, tankCapacity); });
+        return result;
+    }
+
+    // Sends one ship to each target: all ship/target routes are computed in parallel,
+    // then pairs are assigned greedily by increasing fuel. Targets no free ship can
+    // reach are left out.
+    vector<FleetAssignment> assign(const vector<Ship*>& ships, const vector<Port*>& targets, double tankCapacity) const {
+        vector<Route> all(ships.size() * targets.size());
+        parallelFor(all.size(), [&](size_t k) {
+            all[k] = route(*ships[k / targets.size()], targets[k % targets.size()], tankCapacity);
+        });
+        vector<size_t> order;
+        for (size_t k = 0; k < all.size(); ++k) if (all[k].reachable) order.push_back(k);
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) { return all[a].fuel < all[b].fuel; });
+
+        vector<char> shipUsed(ships.size(), 0), targetUsed(targets.size(), 0);
+        vector<FleetAssignment> result;
+        for (size_t k : order) {
+            const size_t s = k / targets.size(), t = k % targets.size();
+            if (shipUsed[s] || targetUsed[t]) continue;
+            shipUsed[s] = targetUsed[t] = 1;
+            result.push_back({ships[s], targets[t], move(all[k])});
+        }
+        return result;
+    }
+};
+
+// ---- Discrete-event simulation ----
+//
+// Ports, ships and containers live in pools reserved up front, so the raw pointers
+// between them stay valid. Ports are split into regions (longitude bands); each region
+// has its own event queue and is processed by one thread. Synchronization between
+// regions is conservative, with fixed time windows: the lookahead is the shortest
+// possible sailing time between two ports in different regions, so every event a
+// region sends to another during a window lands after the window ends. At each window
+// barrier the exchanged arrivals are merged in a fixed order, so the result does not
+// depend on the number of threads. Destinations come from the port geography alone
+// (nearest ports, plus occasional long hauls), so regions only decide which thread
+// runs an event, not where ships go.
+struct SimConfig {
+    size_t ports = 1000;
+    size_t ships = 5000;
+    size_t containers = 200000;
+    unsigned regions = 8;
+    unsigned threads = 0;            // 0 = min(regions, hardware_concurrency)
+    double hours = 24 * 30;          // simulated time
+    double speed = 1.0;              // distance units per hour
+    double serviceHours = 2.0;       // fixed time in port
+    size_t nearbyPorts = 16;         // local voyages go to one of this many closest ports
+    double longHaulChance = 0.05;    // share of voyages to any port in the world
+    uint64_t seed = 1;
+};
+
+struct SimStats {
+    uint64_t events = 0;
+    uint64_t voyages = 0;
+    uint64_t crossRegionVoyages = 0;
+    uint64_t failedDepartures = 0; // depart() refused; the ship stays and tries again later
+    uint64_t containersMoved = 0;
+    uint64_t windows = 0;
+    double fuelBought = 0;
+    double wallSeconds = 0;
+    double eventsPerSecond() const { return wallSeconds > 0 ? events / wallSeconds : 0; }
+};
+
+// std::barrier is C++20; this is the same idea for a fixed number of threads.
+class SimBarrier {
+private:
+    mutex m;
+    condition_variable cv;
+    size_t parties, waiting = 0, generation = 0;
+public:
+    explicit SimBarrier(size_t n) : parties(n) {}
+
+    void arriveAndWait() {
+        unique_lock<mutex> lock(m);
+        const size_t gen = generation;
+        if (++waiting == parties) {
+            waiting = 0;
+            ++generation;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return generation != gen; });
+    }
+};
+
+class PortSimulation {
+private:
+    enum class EventType : uint8_t { Arrive, Depart };
+
+    struct Event {
+        double time;
+        uint64_t seq; // tie-breaker, keeps the order deterministic
+        EventType type;
+        uint32_t ship;
+        uint32_t port;
+        bool operator>(const Event& o) const { return time != o.time ? time > o.time : seq > o.seq; }
+    };
+
+    struct Region {
+        priority_queue<Event, vector<Event>, greater<Event>> queue;
+        vector<Event> outbox; // arrivals for other regions produced in the current window
+        uint64_t seq = 0;
+        SimStats stats;
+    };
+
+    SimConfig config;
+    vector<Port> ports;
+    vector<Ship> ships;
+    vector<BasicContainer> basic;
+    vector<HeavyContainer> heavy;
+    vector<RefrigeratedContainer> refrigerated;
+    vector<LiquidContainer> liquid;
+    vector<unsigned> regionOf;  // port -> region
+    vector<uint32_t> nearby;    // nearbyCount closest ports of each port, port-major
+    size_t nearbyCount = 0;
+    vector<uint64_t> shipRng;   // per-ship random state, only touched by the owning region
+    vector<Region> regions;
+    double lookahead = 0;
+
+    static uint64_t next(uint64_t& x) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        return x;
+    }
+
+    void push(Region& r, double time, EventType type, uint32_t ship, uint32_t port) {
+        r.queue.push({time, r.seq++, type, ship, port});
+    }
+
+    // Unloads everything, then fills the hold from the port's inventory, kind by kind.
+    void service(Region& r, Ship& ship, Port& port) {
+        r.stats.containersMoved += ship.unLoadAll();
+        for (size_t k = 0; k < kContainerKinds; ++k) {
+            const auto& bucket = port.getInventory().ofKind(static_cast<ContainerKind>(k));
+            while (!bucket.empty()) {
+                Container* c = port.getContainer(bucket.back());
+                if (!ship.load(c)) {
+                    port.addContainer(c);
+                    break;
+                }
+                ++r.stats.containersMoved;
+            }
+        }
+    }
+
+    void process(Region& r, const Event& e) {
+        ++r.stats.events;
+        Ship& ship = ships[e.ship];
+        Port& port = ports[e.port];
+        port.setClock(e.time);
+        if (e.type == EventType::Arrive) {
+            ship.arrive();
+            service(r, ship, port);
+            push(r, e.time + config.serviceHours, EventType::Depart, e.ship, e.port);
+            return;
+        }
+
+        // Depart: pick the next port, buy the fuel the trip needs, and sail.
+        uint64_t& rng = shipRng[e.ship];
+        uint32_t to = e.port;
+        const bool longHaul = (next(rng) % 10000) < config.longHaulChance * 10000 || nearbyCount == 0;
+        if (!longHaul) {
+            to = nearby[e.port * nearbyCount + next(rng) % nearbyCount];
+        } else {
+            while (to == e.port && ports.size() > 1) to = static_cast<uint32_t>(next(rng) % ports.size());
+        }
+        const double dist = port.getDistance(ports[to]);
+        const double required = ship.fuelFor(ports[to]);
+        if (ship.getFuel() < required) {
+            r.stats.fuelBought += required - ship.getFuel();
+            ship.reFuel(required - ship.getFuel());
+        }
+        // fuel + (required - fuel) can round to just below required: then the ship stays
+        // berthed and retries after another service period instead of sailing unrecorded.
+        if (!ship.depart(&ports[to])) {
+            ++r.stats.failedDepartures;
+            push(r, e.time + config.serviceHours, EventType::Depart, e.ship, e.port);
+            return;
+        }
+        ++r.stats.voyages;
+
+        const double arrival = e.time + dist / config.speed;
+        if (regionOf[to] == regionOf[e.port]) {
+            push(r, arrival, EventType::Arrive, e.ship, to);
+        } else {
+            ++r.stats.crossRegionVoyages;
+            r.outbox.push_back({arrival, 0, EventType::Arrive, e.ship, to});
+        }
+    }
+
+    // Processes every event of the region before windowEnd (or at exactly windowEnd when
+    // there is no lookahead).
+    void runWindow(Region& r, double windowEnd, bool inclusive) {
+        while (!r.queue.empty()) {
+            const Event e = r.queue.top();
+            if (e.time > config.hours || (inclusive ? e.time > windowEnd : e.time >= windowEnd)) break;
+            r.queue.pop();
+            process(r, e);
+        }
+    }
+public:
+    explicit PortSimulation(SimConfig c) : config(c) {
+        config.regions = max(1u, config.regions);
+        uint64_t x = config.seed * 0x9E3779B97F4A7C15ull + 1;
+        ports.reserve(config.ports);
+        ships.reserve(config.ships);
+        regions.resize(config.regions);
+
+        for (size_t i = 0; i < config.ports; ++i) {
+            const double lat = (next(x) % 18000) / 100.0 - 90, lon = (next(x) % 36000) / 100.0 - 180;
+            ports.emplace_back(static_cast<int>(i), lat, lon);
+            const unsigned region = min(config.regions - 1, static_cast<unsigned>((lon + 180) / 360 * config.regions));
+            regionOf.push_back(region);
+        }
+        nearbyCount = ports.empty() ? 0 : min(config.nearbyPorts, ports.size() - 1);
+        nearby.reserve(ports.size() * nearbyCount);
+        vector<pair<double, uint32_t>> byDistance;
+        for (size_t i = 0; i < ports.size() && nearbyCount; ++i) {
+            byDistance.clear();
+            for (size_t j = 0; j < ports.size(); ++j)
+                if (j != i) byDistance.emplace_back(ports[i].getDistance(ports[j]), static_cast<uint32_t>(j));
+            partial_sort(byDistance.begin(), byDistance.begin() + nearbyCount, byDistance.end());
+            for (size_t k = 0; k < nearbyCount; ++k) nearby.push_back(byDistance[k].second);
+        }
+
+        const size_t perKind = config.containers / kContainerKinds + 1;
+        basic.reserve(perKind); heavy.reserve(perKind); refrigerated.reserve(perKind); liquid.reserve(perKind);
+        for (size_t i = 0; i < config.containers; ++i) {
+            const int id = static_cast<int>(i), w = 500 + static_cast<int>(next(x) % 4000);
+            Container* c;
+            switch (i % kContainerKinds) {
+                case 0: basic.emplace_back(id, w); c = &basic.back(); break;
+                case 1: heavy.emplace_back(id, w); c = &heavy.back(); break;
+                case 2: refrigerated.emplace_back(id, w); c = &refrigerated.back(); break;
+                default: liquid.emplace_back(id, w); c = &liquid.back(); break;
+            }
+            ports[next(x) % ports.size()].addContainer(c);
+        }
+
+        for (size_t i = 0; i < config.ships; ++i) {
+            const uint32_t home = static_cast<uint32_t>(next(x) % ports.size());
+            ships.emplace_back(static_cast<int>(i), &ports[home], 60000, 20, 8, 4, 4, 0.5);
+            shipRng.push_back(next(x) | 1);
+            Region& r = regions[regionOf[home]];
+            push(r, (next(x) % 1000) / 1000.0 * config.serviceHours, EventType::Depart, static_cast<uint32_t>(i), home);
+        }
+
+        // Lookahead: shortest distance between ports of different regions, over speed.
+        lookahead = numeric_limits<double>::infinity();
+        for (size_t i = 0; i < ports.size(); ++i)
+            for (size_t j = i + 1; j < ports.size(); ++j)
+                if (regionOf[i] != regionOf[j]) lookahead = min(lookahead, ports[i].getDistance(ports[j]) / config.speed);
+        if (lookahead == numeric_limits<double>::infinity()) lookahead = config.hours + 1;
+    }
+
+    SimStats run() {
+        const unsigned hw = max(1u, thread::hardware_concurrency());
+        const unsigned threads = config.threads ? min(config.threads, config.regions) : min(config.regions, hw);
+        SimBarrier barrier(threads);
+        double windowStart = 0;
+        bool finished = false;
+        uint64_t windows = 0;
+
+        // Thread 0 also does the merge between windows while the others wait.
+        auto worker = [&](unsigned t) {
+            for (;;) {
+                barrier.arriveAndWait();
+                if (finished) return;
+                const bool inclusive = lookahead <= 0;
+                for (size_t r = t; r < regions.size(); r += threads) runWindow(regions[r], windowStart + lookahead, inclusive);
+                barrier.arriveAndWait();
+                if (t != 0) continue;
+
+                ++windows;
+                for (auto& from : regions) {
+                    for (const Event& e : from.outbox) push(regions[regionOf[e.port]], e.time, e.type, e.ship, e.port);
+                    from.outbox.clear();
+                }
+                double earliest = numeric_limits<double>::infinity();
+                for (auto& r : regions) if (!r.queue.empty()) earliest = min(earliest, r.queue.top().time);
+                if (earliest > config.hours) finished = true;
+                else windowStart = inclusive ? earliest : max(windowStart + lookahead, earliest);
+            }
+        };
+
+        const auto start = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& th : pool) th.join();
+
+        SimStats total;
+        for (const auto& r : regions) {
+            total.events += r.stats.events;
+            total.voyages += r.stats.voyages;
+            total.crossRegionVoyages += r.stats.crossRegionVoyages;
+            total.failedDepartures += r.stats.failedDepartures;
+            total.containersMoved += r.stats.containersMoved;
+            total.fuelBought += r.stats.fuelBought;
+        }
+        total.windows = windows;
+        total.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return total;
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "sim") {
+        // ./main sim [ports] [ships] [regions] [threads] [days]
+        SimConfig config;
+        if (argc > 2) config.ports = stoul(argv[2]);
+        if (argc > 3) config.ships = stoul(argv[3]);
+        if (argc > 4) config.regions = stoul(argv[4]);
+        if (argc > 5) config.threads = stoul(argv[5]);
+        if (argc > 6) config.hours = 24 * stod(argv[6]);
+        PortSimulation sim(config);
+        const SimStats stats = sim.run();
+        cout << stats.events << " events in " << fixed << setprecision(3) << stats.wallSeconds << " s ("
+             << setprecision(0) << stats.eventsPerSecond() << " events/s), " << stats.windows << " windows\n"
+             << stats.voyages << " voyages (" << stats.crossRegionVoyages << " between regions), "
+             << stats.containersMoved << " container moves, fuel bought " << setprecision(1) << stats.fuelBought << "\n";
+        if (stats.failedDepartures) cout << stats.failedDepartures << " departures refused and retried\n";
+        return 0;
+    }
     cout << "=== Port Management Simulation (Local Data) ===\n";
 
     // Create ports
@@ -253,10 +1163,27 @@ int main() {
     } else
         cout << "Not enough fuel.\n";
 
+    // Ship 1 plans a load from port 2 worth carrying back to port 1.
+    s2.reFuel(500);
+    LoadPlanOptions planOptions;
+    planOptions.destination = &p1;
+    planOptions.fuelPrice = 2.0;
+    LoadPlan plan = s2.planLoad(p2, planOptions);
+    cout << "\nShip 1 plan: " << plan.containers.size() << " containers, weight " << plan.weight
+         << ", value " << plan.value << ", fuel cost " << plan.fuelCost << "\n";
+    s2.applyPlan(p2, plan);
+
+    // Fleet routing: ship 1 is at port 2 and has to reach port 1.
+    FleetRouter router({&p1, &p2});
+    Route back = router.route(s2, &p1, 500);
+    cout << "Ship 1 route to port 0: " << (back.reachable ? "reachable" : "unreachable")
+         << ", distance " << back.distance << ", fuel " << back.fuel << "\n";
+
     cout << "\n-- After sailing --\n";
     p1.printState();
     p2.printState();
     s1.printState();
+    s2.printState();
 
     return 0;
 }
@@ -5,7 +5,20 @@
 #include <algorithm>
 #include <stdexcept>
 #include <sstream>
-#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <string_view>
+#include <charconv>
+#include <array>
+
+#include "../common/instrument.h"
 
 class Teacher {
 protected:
@@ -14,13 +27,13 @@ public:
     explicit Teacher(const std::string& n) : name(n) {}
     virtual ~Teacher() = default;
     
-    std::string getName() const { return name; }
+    const std::string& getName() const { return name; }
     
     virtual bool canTeachLecture() const = 0;
     virtual bool canTeachPractical() const = 0;
     virtual bool canSuperviseCourseWork() const = 0;
     
-    virtual std::string getType() const = 0;
+    virtual std::string_view getType() const = 0;
 };
 
 class Lecturer : public Teacher {
@@ -30,7 +43,7 @@ public:
     bool canTeachLecture() const override { return true; }
     bool canTeachPractical() const override { return true; }
     bool canSuperviseCourseWork() const override { return true; }
-    std::string getType() const override { return "Lecturer"; }
+    std::string_view getType() const override { return "Lecturer"; }
 };
 
 class Assistant : public Teacher {
@@ -40,7 +53,7 @@ public:
     bool canTeachLecture() const override { return false; }
     bool canTeachPractical() const override { return true; }
     bool canSuperviseCourseWork() const override { return true; }
-    std::string getType() const override { return "Assistant"; }
+    std::string_view getType() const override { return "Assistant"; }
 };
 
 class ExternalMentor : public Teacher {
@@ -50,58 +63,181 @@ public:
     bool canTeachLecture() const override { return false; }
     bool canTeachPractical() const override { return false; }
     bool canSuperviseCourseWork() const override { return true; }
-    std::string getType() const override { return "External Mentor"; }
+    std::string_view getType() const override { return "External Mentor"; }
+};
+
+// Час заняття у хвилинах від початку тижня (Mon 00:00 = 0), інтервал [start, end).
+struct TimeSlot {
+    std::int32_t start;
+    std::int32_t end;
+
+    bool overlaps(const TimeSlot& other) const { return start < other.end && other.start < end; }
+};
+
+constexpr std::int32_t kDefaultSessionMinutes = 90; // одна пара
+
+// Parses "Mon 10:00" (default length) or "Mon 10:00-11:30".
+TimeSlot parseTimeSlot(std::string_view text) {
+    static const char* const days[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+    auto fail = [&]() -> TimeSlot { throw std::invalid_argument("Invalid session time: '" + std::string(text) + "'"); };
+
+    std::size_t pos = 0;
+    auto readClock = [&](std::int32_t& minutes) {
+        int h = 0, m = 0, digits = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && digits < 2) {
+            h = h * 10 + (text[pos++] - '0');
+            ++digits;
+        }
+        if (digits == 0 || pos >= text.size() || text[pos] != ':') return false;
+        ++pos;
+        for (int i = 0; i < 2; ++i, ++pos) {
+            if (pos >= text.size() || text[pos] < '0' || text[pos] > '9') return false;
+            m = m * 10 + (text[pos] - '0');
+        }
+        if (h > 24 || m > 59 || (h == 24 && m != 0)) return false;
+        minutes = h * 60 + m;
+        return true;
+    };
+
+    if (text.size() < 4 || text[3] != ' ') return fail();
+    int day = 0;
+    while (day < 7 && text.compare(0, 3, days[day]) != 0) ++day;
+    if (day == 7) return fail();
+    pos = 4;
+
+    std::int32_t from = 0, to = 0;
+    if (!readClock(from)) return fail();
+    if (pos == text.size()) {
+        to = from + kDefaultSessionMinutes;
+    } else {
+        if (text[pos++] != '-' || !readClock(to) || pos != text.size() || to <= from) return fail();
+    }
+    const std::int32_t dayStart = day * 24 * 60;
+    return {dayStart + from, dayStart + to};
+}
+
+using SymbolId = std::uint32_t;
+
+// Таблиця інтернованих рядків (назви аудиторій, рядки часу). Тисячі занять в одній аудиторії
+// ділять один рядок, а заняття зберігає лише 4-байтовий id. Рядки лежать у блоках, які ніколи
+// не переміщуються, тому text() читає без блокування; intern() синхронізований.
+class SymbolTable {
+private:
+    static constexpr std::size_t kChunkBits = 12;
+    static constexpr std::size_t kChunkSize = std::size_t{1} << kChunkBits;
+    static constexpr std::size_t kMaxChunks = 1024;
+
+    std::array<std::unique_ptr<std::string[]>, kMaxChunks> chunks;
+    std::unordered_map<std::string_view, SymbolId> ids;
+    std::size_t count = 0;
+    std::mutex mutex;
+
+public:
+    SymbolId intern(std::string_view text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(text);
+        if (it != ids.end()) return it->second;
+        if (count == kChunkSize * kMaxChunks) throw std::length_error("SymbolTable is full");
+        auto& chunk = chunks[count >> kChunkBits];
+        if (!chunk) chunk.reset(new std::string[kChunkSize]);
+        std::string& stored = chunk[count & (kChunkSize - 1)];
+        stored.assign(text);
+        const auto id = static_cast<SymbolId>(count++);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view text(SymbolId id) const { return chunks[id >> kChunkBits][id & (kChunkSize - 1)]; }
+
+    static SymbolTable& global() {
+        static SymbolTable table;
+        return table;
+    }
+};
+
+// Володіє викладачами, яких призначено на заняття. Заняття зберігає лише const Teacher*,
+// тож копіювання й знищення занять не чіпає атомарний лічильник shared_ptr. Як і рядки
+// SymbolTable, викладачі живуть до кінця програми.
+class TeacherRegistry {
+private:
+    std::unordered_map<const Teacher*, std::shared_ptr<const Teacher>> owned;
+    std::mutex mutex;
+
+public:
+    const Teacher* retain(std::shared_ptr<const Teacher> teacher) {
+        if (!teacher) throw std::invalid_argument("Session needs a teacher");
+        const Teacher* raw = teacher.get();
+        std::lock_guard<std::mutex> lock(mutex);
+        owned.emplace(raw, std::move(teacher));
+        return raw;
+    }
+
+    static TeacherRegistry& global() {
+        static TeacherRegistry registry;
+        return registry;
+    }
 };
 
 class Session {
 protected:
-    std::string time;
-    std::string room;
-    std::shared_ptr<Teacher> teacher;
+    SymbolId timeId;
+    SymbolId roomId;
+    TimeSlot slot;
+    const Teacher* teacher; // не володіє: викладача тримає TeacherRegistry
     
 public:
     // ЦЕЙ РЯДОК ВИПРАВЛЕНО
-    Session(const std::string& t, const std::string& r, std::shared_ptr<Teacher> teach)
-        : time(t), room(r), teacher(std::move(teach)) {}
+    Session(std::string_view t, std::string_view r, std::shared_ptr<Teacher> teach)
+        : timeId(SymbolTable::global().intern(t)), roomId(SymbolTable::global().intern(r)),
+          slot(parseTimeSlot(t)), teacher(TeacherRegistry::global().retain(std::move(teach))) {}
     
     virtual ~Session() = default;
     
-    std::string getTime() const { return time; }
-    std::string getRoom() const { return room; }
-    std::shared_ptr<Teacher> getTeacher() const { return teacher; }
+    std::string_view getTime() const { return SymbolTable::global().text(timeId); }
+    TimeSlot getSlot() const { return slot; }
+    std::string_view getRoom() const { return SymbolTable::global().text(roomId); }
+    SymbolId getTimeId() const { return timeId; }
+    SymbolId getRoomId() const { return roomId; }
+    const Teacher& getTeacher() const { return *teacher; }
     
-    virtual std::string getType() const = 0;
+    virtual std::string_view getType() const = 0;
     
-    virtual std::string getInfo() const {
-        std::stringstream ss;
-        ss << getType() << " | " << time << " | Room: " << room 
-           << " | Teacher: " << teacher->getName() << " (" << teacher->getType() << ")";
-        return ss.str();
+    // Appends the one-line description to `out`; no allocation once `out` has the capacity.
+    virtual void appendInfo(std::string& out) const {
+        out.append(getType()).append(" | ").append(getTime()).append(" | Room: ").append(getRoom())
+           .append(" | Teacher: ").append(teacher->getName())
+           .append(" (").append(teacher->getType()).append(")");
+    }
+
+    std::string getInfo() const {
+        std::string out;
+        appendInfo(out);
+        return out;
     }
 };
 
 class LectureSession : public Session {
 public:
-    LectureSession(const std::string& t, const std::string& r, std::shared_ptr<Teacher> teach)
+    LectureSession(std::string_view t, std::string_view r, std::shared_ptr<Teacher> teach)
         : Session(t, r, std::move(teach)) {
         if (!teacher->canTeachLecture()) {
             throw std::invalid_argument(teacher->getName() + " cannot teach lectures!");
         }
     }
     
-    std::string getType() const override { return "Lecture"; }
+    std::string_view getType() const override { return "Lecture"; }
 };
 
 class PracticalSession : public Session {
 public:
-    PracticalSession(const std::string& t, const std::string& r, std::shared_ptr<Teacher> teach)
+    PracticalSession(std::string_view t, std::string_view r, std::shared_ptr<Teacher> teach)
         : Session(t, r, std::move(teach)) {
         if (!teacher->canTeachPractical()) {
             throw std::invalid_argument(teacher->getName() + " cannot teach practicals!");
         }
     }
     
-    std::string getType() const override { return "Practical"; }
+    std::string_view getType() const override { return "Practical"; }
 };
 
 class SessionFactory {
@@ -269,41 +405,244 @@ public:
     }
 };
 
+// Інтервальне дерево: AVL за початком інтервалу, кожен вузол зберігає максимальний кінець
+// у своєму піддереві. Вузли лежать у векторі, тож вставка не виділяє пам'ять по одному вузлу.
+template <typename T>
+class IntervalTree {
+private:
+    static constexpr std::int32_t kNil = -1;
+
+    struct Node {
+        TimeSlot slot;
+        std::int32_t maxEnd;
+        std::int32_t left = kNil, right = kNil;
+        std::int32_t height = 1;
+        T value;
+    };
+
+    std::vector<Node> nodes;
+    std::int32_t root = kNil;
+
+    std::int32_t height(std::int32_t n) const { return n == kNil ? 0 : nodes[n].height; }
+    std::int32_t maxEnd(std::int32_t n) const { return n == kNil ? INT32_MIN : nodes[n].maxEnd; }
+
+    void update(std::int32_t n) {
+        Node& node = nodes[n];
+        node.height = 1 + std::max(height(node.left), height(node.right));
+        node.maxEnd = std::max({node.slot.end, maxEnd(node.left), maxEnd(node.right)});
+    }
+
+    std::int32_t rotateRight(std::int32_t n) {
+        const std::int32_t l = nodes[n].left;
+        nodes[n].left = nodes[l].right;
+        nodes[l].right = n;
+        update(n);
+        update(l);
+        return l;
+    }
+
+    std::int32_t rotateLeft(std::int32_t n) {
+        const std::int32_t r = nodes[n].right;
+        nodes[n].right = nodes[r].left;
+        nodes[r].left = n;
+        update(n);
+        update(r);
+        return r;
+    }
+
+    std::int32_t insertAt(std::int32_t n, std::int32_t fresh) {
+        if (n == kNil) return fresh;
+        // Рівні початки йдуть праворуч, тож порядок вставки зберігається
+        if (nodes[fresh].slot.start < nodes[n].slot.start) {
+            const std::int32_t child = insertAt(nodes[n].left, fresh);
+            nodes[n].left = child;
+        } else {
+            const std::int32_t child = insertAt(nodes[n].right, fresh);
+            nodes[n].right = child;
+        }
+        update(n);
+
+        const std::int32_t balance = height(nodes[n].left) - height(nodes[n].right);
+        if (balance > 1) {
+            if (height(nodes[nodes[n].left].left) < height(nodes[nodes[n].left].right))
+                nodes[n].left = rotateLeft(nodes[n].left);
+            return rotateRight(n);
+        }
+        if (balance < -1) {
+            if (height(nodes[nodes[n].right].right) < height(nodes[nodes[n].right].left))
+                nodes[n].right = rotateRight(nodes[n].right);
+            return rotateLeft(n);
+        }
+        return n;
+    }
+
+    template <typename Fn>
+    void visit(std::int32_t n, const TimeSlot& q, Fn& fn) const {
+        if (n == kNil || nodes[n].maxEnd <= q.start) return;
+        const Node& node = nodes[n];
+        visit(node.left, q, fn);
+        if (node.slot.start >= q.end) return; // праворуч усі починаються ще пізніше
+        if (node.slot.overlaps(q)) fn(node.value);
+        visit(node.right, q, fn);
+    }
+
+public:
+    void insert(const TimeSlot& slot, T value) {
+        nodes.push_back(Node{slot, slot.end, kNil, kNil, 1, std::move(value)});
+        root = insertAt(root, static_cast<std::int32_t>(nodes.size() - 1));
+    }
+
+    // Calls fn(value) for every stored interval overlapping q: O(log n + k).
+    template <typename Fn>
+    void forEachOverlap(const TimeSlot& q, Fn fn) const { visit(root, q, fn); }
+
+    std::size_t size() const { return nodes.size(); }
+};
+
+class StudentGroup;
+
+enum ConflictKind : std::uint8_t {
+    RoomConflict = 1,
+    TeacherConflict = 2,
+    GroupConflict = 4
+};
+
+struct Conflict {
+    std::uint8_t kinds; // набір ConflictKind
+    const Session* first;  // заняття, що вже було в розкладі (живе, поки живе Timetable)
+    const Session* second; // нове заняття
+    const StudentGroup* firstGroup;
+    const StudentGroup* secondGroup;
+};
+
+std::string describeConflictKinds(std::uint8_t kinds) {
+    std::string out;
+    if (kinds & RoomConflict) out += "room";
+    if (kinds & TeacherConflict) out += out.empty() ? "teacher" : ", teacher";
+    if (kinds & GroupConflict) out += out.empty() ? "group" : ", group";
+    return out;
+}
+
+// Розклад, спільний для кількох груп (або для всього університету). Кожне заняття потрапляє
+// в інтервальні дерева своєї аудиторії, викладача та групи, тому перевірка при вставці
+// коштує O(log n + кількість конфліктів), а не прохід по всьому розкладу.
+class Timetable {
+private:
+    struct Entry {
+        std::shared_ptr<Session> session;
+        const StudentGroup* group;
+        bool conflicted = false;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<SymbolId, IntervalTree<std::size_t>> byRoom;
+    std::unordered_map<const Teacher*, IntervalTree<std::size_t>> byTeacher;
+    std::unordered_map<const StudentGroup*, IntervalTree<std::size_t>> byGroup;
+    std::vector<Conflict> log;
+
+public:
+    // Adds the session and returns its entry id. Every overlap found is appended to the log.
+    std::size_t add(std::shared_ptr<Session> session, const StudentGroup* group) {
+        INSTR_SPAN("lab3.Timetable::add");
+        const std::size_t id = entries.size();
+        const TimeSlot slot = session->getSlot();
+        auto& roomTree = byRoom[session->getRoomId()];
+        auto& teacherTree = byTeacher[&session->getTeacher()];
+        auto& groupTree = byGroup[group];
+
+        // Одна пара занять може збігтися і за аудиторією, і за викладачем - об'єднуємо
+        std::vector<std::pair<std::size_t, std::uint8_t>> hits;
+        auto collect = [&](std::uint8_t kind) {
+            return [&hits, kind](std::size_t other) {
+                for (auto& h : hits) {
+                    if (h.first == other) { h.second |= kind; return; }
+                }
+                hits.emplace_back(other, kind);
+            };
+        };
+        roomTree.forEachOverlap(slot, collect(RoomConflict));
+        teacherTree.forEachOverlap(slot, collect(TeacherConflict));
+        groupTree.forEachOverlap(slot, collect(GroupConflict));
+
+        entries.push_back(Entry{session, group, !hits.empty()});
+        std::sort(hits.begin(), hits.end());
+        for (const auto& h : hits) {
+            entries[h.first].conflicted = true;
+            log.push_back(Conflict{h.second, entries[h.first].session.get(), session.get(), entries[h.first].group, group});
+        }
+
+        roomTree.insert(slot, id);
+        teacherTree.insert(slot, id);
+        groupTree.insert(slot, id);
+        return id;
+    }
+
+    bool isConflicted(std::size_t id) const { return entries[id].conflicted; }
+    std::size_t size() const { return entries.size(); }
+
+    // Conflicts found since `cursor`; moves the cursor to the end of the log.
+    std::vector<Conflict> conflictsSince(std::size_t& cursor) const {
+        std::vector<Conflict> out(log.begin() + std::min(cursor, log.size()), log.end());
+        cursor = log.size();
+        return out;
+    }
+
+    const std::vector<Conflict>& allConflicts() const { return log; }
+};
+
 class StudentGroup {
 private:
     std::string name;
     std::vector<std::shared_ptr<Session>> sessions;
     std::vector<std::string> students;
+    std::shared_ptr<Timetable> timetable;
+    std::vector<std::size_t> entryIds; // id кожного заняття у timetable, паралельно до sessions
+    std::size_t conflictCursor = 0;
     
 public:
-    explicit StudentGroup(const std::string& n) : name(n) {}
+    // Groups that share one timetable also see room and teacher clashes between each other.
+    explicit StudentGroup(const std::string& n, std::shared_ptr<Timetable> tt = nullptr)
+        : name(n), timetable(tt ? std::move(tt) : std::make_shared<Timetable>()) {}
+
+    // The timetable keys entries and conflicts by the group's address, so a copied or
+    // moved group would leave it pointing at the old object. Not copyable or movable.
+    StudentGroup(const StudentGroup&) = delete;
+    StudentGroup& operator=(const StudentGroup&) = delete;
     
     void addStudent(const std::string& studentName) {
         students.emplace_back(studentName);
     }
     
     void addSession(std::shared_ptr<Session> session) {
+        entryIds.push_back(timetable->add(session, this));
         sessions.emplace_back(std::move(session));
     }
     
+    // Sessions of this group that overlap another session in time (same room, teacher or group).
     std::vector<std::shared_ptr<Session>> checkConflicts() const {
-        std::map<std::string, std::vector<std::shared_ptr<Session>>> timeMap;
-        for (const auto& s : sessions) {
-            timeMap[s->getTime()].push_back(s);
-        }
-        
+        INSTR_SPAN("lab3.StudentGroup::checkConflicts");
         std::vector<std::shared_ptr<Session>> conflicts;
-        for (const auto& pair : timeMap) {
-            if (pair.second.size() > 1) {
-                conflicts.insert(conflicts.end(), pair.second.begin(), pair.second.end());
-            }
+        for (std::size_t i = 0; i < sessions.size(); ++i) {
+            if (timetable->isConflicted(entryIds[i])) conflicts.push_back(sessions[i]);
         }
         return conflicts;
     }
 
+    // Conflicts involving this group that were detected since the previous call.
+    std::vector<Conflict> takeNewConflicts() {
+        std::vector<Conflict> fresh = timetable->conflictsSince(conflictCursor);
+        fresh.erase(std::remove_if(fresh.begin(), fresh.end(), [this](const Conflict& c) {
+                        return c.firstGroup != this && c.secondGroup != this;
+                    }), fresh.end());
+        return fresh;
+    }
+
+    std::shared_ptr<Timetable> getTimetable() const { return timetable; }
+
     void enroll(const std::shared_ptr<CourseFactory>& factory, const std::string& courseName,
                 std::shared_ptr<Teacher> lecturer, std::shared_ptr<Teacher> assistant,
                 std::shared_ptr<Teacher> supervisor) {
+        INSTR_SPAN("lab3.StudentGroup::enroll");
         
         std::cout << "\n📚 Enrolling group " << name << " in " << courseName << "..." << std::endl;
         
@@ -321,31 +660,409 @@ public:
 
             std::cout << "  ✓ Assigned: " << coursework->getInfo() << std::endl;
         } catch (const std::invalid_argument& e) {
+            INSTR_COUNT("lab3.StudentGroup::enroll.failed");
             std::cerr << "  ✗ ERROR enrolling in " << courseName << ": " << e.what() << std::endl;
         }
     }
     
-    std::string getSchedule() const {
-        std::stringstream ss;
-        ss << "\n📅 Schedule for group " << name << ":\n";
-        ss << "────────────────────────────────────────────────────\n";
+    // Appends the schedule to `out`. Reusing one buffer across calls (out.clear() keeps the
+    // capacity) renders any number of groups without per-session allocations.
+    void writeSchedule(std::string& out) const {
+        INSTR_SPAN("lab3.StudentGroup::writeSchedule");
+        out.append("\n📅 Schedule for group ").append(name).append(":\n");
+        out.append("────────────────────────────────────────────────────\n");
         
-        for (const auto& session : sessions) {
-            ss << "  • " << session->getInfo() << "\n";
+        std::size_t conflicted = 0;
+        for (std::size_t i = 0; i < sessions.size(); ++i) {
+            out.append("  • ");
+            sessions[i]->appendInfo(out);
+            out.push_back('\n');
+            if (timetable->isConflicted(entryIds[i])) ++conflicted;
         }
         
-        auto conflicts = checkConflicts();
-        if (!conflicts.empty()) {
-            ss << "\n⚠️  WARNING: " << conflicts.size() << " session(s) involved in scheduling conflict(s)!\n";
-            for (const auto& conflict : conflicts) {
-                ss << "      -> CONFLICT: " << conflict->getInfo() << "\n";
+        if (conflicted > 0) {
+            char digits[24];
+            const auto end = std::to_chars(digits, digits + sizeof digits, conflicted).ptr;
+            out.append("\n⚠️  WARNING: ").append(digits, end).append(" session(s) involved in scheduling conflict(s)!\n");
+            for (std::size_t i = 0; i < sessions.size(); ++i) {
+                if (!timetable->isConflicted(entryIds[i])) continue;
+                out.append("      -> CONFLICT: ");
+                sessions[i]->appendInfo(out);
+                out.push_back('\n');
             }
         }
-        
-        return ss.str();
+    }
+
+    std::string getSchedule() const {
+        std::string out;
+        writeSchedule(out);
+        return out;
     }
     
-    std::string getName() const { return name; }
+    const std::string& getName() const { return name; }
+    std::size_t getStudentCount() const { return students.size(); }
+};
+
+// ===== Автоматичне складання розкладу =====
+
+struct Room {
+    std::string name;
+    std::size_t capacity;
+    bool lectureHall; // лекції - тільки в аудиторіях, практики - будь-де
+};
+
+struct CourseRequest {
+    StudentGroup* group;
+    std::shared_ptr<CourseFactory> factory;
+    std::string courseName;
+    std::shared_ptr<Teacher> lecturer;  // nullptr: будь-хто зі штату, хто може читати лекції
+    std::shared_ptr<Teacher> assistant; // nullptr: будь-хто зі штату, хто веде практики
+};
+
+struct SchedulerOptions {
+    int days = 5;
+    int periodsPerDay = 6;
+    int firstPeriodStart = 8 * 60 + 30;
+    int periodMinutes = 80;
+    int breakMinutes = 10;
+    std::chrono::milliseconds timeBudget{2000}; // per search pass, counted after the problem is built
+    unsigned threads = 0;                 // 0 = std::thread::hardware_concurrency()
+    std::size_t stepsPerRestart = 200000; // local-search steps before the next restart
+    std::uint64_t seed = 1;
+};
+
+struct ScheduledSession {
+    StudentGroup* group;
+    std::string courseName;
+    bool lecture;
+    int slot;
+    std::size_t room;
+    const Teacher* teacher;           // не володіє: викладача тримає TeacherRegistry
+    std::shared_ptr<Session> session; // створено фабрикою курсу
+};
+
+struct ScheduleResult {
+    std::vector<ScheduledSession> sessions;
+    std::size_t violations = 0; // room/teacher/group double bookings left
+    std::size_t restarts = 0;
+    double seconds = 0;
+
+    bool complete() const { return violations == 0; }
+};
+
+// Builds a timetable for the requested courses: one lecture and one practical per request,
+// placed into (slot, room, teacher) so that no room, teacher or group is booked twice.
+// Min-conflicts local search with tabu; restarts run in parallel until one is conflict-free
+// or the time budget runs out.
+class AutoScheduler {
+private:
+    struct Var {
+        std::size_t group;
+        std::vector<std::int32_t> teachers; // кандидати (індекси в teacherPool)
+        std::vector<std::int32_t> rooms;    // придатні аудиторії
+        bool pinned = false;
+        std::int32_t slot = -1, room = -1, teacher = -1;
+    };
+
+    struct Problem {
+        std::vector<Var> vars;
+        std::vector<std::shared_ptr<Teacher>> teacherPool;
+        std::vector<StudentGroup*> groups;
+        int slots = 0;
+    };
+
+    struct Assignment {
+        std::vector<std::int32_t> slot, room, teacher;
+        std::size_t violations = SIZE_MAX;
+        std::size_t restart = SIZE_MAX;
+    };
+
+    std::vector<Room> rooms;
+    std::vector<std::shared_ptr<Teacher>> staff;
+    SchedulerOptions options;
+
+    Problem buildProblem(const std::vector<CourseRequest>& requests) const {
+        Problem p;
+        p.slots = options.days * options.periodsPerDay;
+        std::unordered_map<const Teacher*, std::int32_t> teacherIndex;
+        std::unordered_map<const StudentGroup*, std::size_t> groupIndex;
+        auto teacherId = [&](const std::shared_ptr<Teacher>& t) {
+            auto it = teacherIndex.emplace(t.get(), static_cast<std::int32_t>(p.teacherPool.size()));
+            if (it.second) p.teacherPool.push_back(t);
+            return it.first->second;
+        };
+        for (const auto& t : staff) teacherId(t);
+
+        for (const auto& req : requests) {
+            auto g = groupIndex.emplace(req.group, p.groups.size());
+            if (g.second) p.groups.push_back(req.group);
+
+            for (bool lecture : {true, false}) {
+                Var v;
+                v.group = g.first->second;
+                const std::string what = (lecture ? "lecture" : "practical") + std::string(" of ") + req.courseName;
+                const auto& pinnedTeacher = lecture ? req.lecturer : req.assistant;
+                if (pinnedTeacher) {
+                    // Перевіряємо тут, а не в createLecture/createPractical після всього пошуку
+                    if (!(lecture ? pinnedTeacher->canTeachLecture() : pinnedTeacher->canTeachPractical()))
+                        throw std::invalid_argument(pinnedTeacher->getName() + " cannot teach the " + what);
+                    v.teachers.push_back(teacherId(pinnedTeacher));
+                } else {
+                    for (const auto& t : staff) {
+                        if (lecture ? t->canTeachLecture() : t->canTeachPractical()) v.teachers.push_back(teacherId(t));
+                    }
+                }
+                for (std::size_t r = 0; r < rooms.size(); ++r) {
+                    if ((!lecture || rooms[r].lectureHall) && rooms[r].capacity >= req.group->getStudentCount())
+                        v.rooms.push_back(static_cast<std::int32_t>(r));
+                }
+                // Спершу найменші придатні аудиторії: лекційні зали лишаються вільними для лекцій
+                std::stable_sort(v.rooms.begin(), v.rooms.end(), [&](std::int32_t a, std::int32_t b) {
+                    return std::make_pair(rooms[a].lectureHall, rooms[a].capacity) <
+                           std::make_pair(rooms[b].lectureHall, rooms[b].capacity);
+                });
+                if (v.teachers.empty()) throw std::invalid_argument("No teacher available for the " + what);
+                if (v.rooms.empty()) throw std::invalid_argument("No room fits the " + what + " for " + req.group->getName());
+                p.vars.push_back(std::move(v));
+            }
+        }
+        return p;
+    }
+
+    // Одна спроба локального пошуку. Лічильники зайнятості: slot x room, slot x teacher, slot x group.
+    static Assignment search(const Problem& p, std::size_t roomCount, std::uint64_t seed, std::size_t maxSteps,
+                             std::chrono::steady_clock::time_point deadline, const std::atomic<bool>& stop) {
+        const std::size_t n = p.vars.size();
+        const std::size_t S = static_cast<std::size_t>(p.slots);
+        const std::size_t T = p.teacherPool.size(), G = p.groups.size();
+        std::vector<std::int32_t> roomUse(S * roomCount), teacherUse(S * T), groupUse(S * G);
+        std::vector<std::size_t> tabu(n * S, 0);
+        std::mt19937_64 rng(seed);
+
+        Assignment a;
+        a.slot.assign(n, -1);
+        a.room.assign(n, -1);
+        a.teacher.assign(n, -1);
+        std::size_t violations = 0;
+
+        auto bump = [&](std::int32_t& c, int d) {
+            if (d > 0) { if (c++ >= 1) ++violations; }
+            else { if (c-- >= 2) --violations; }
+        };
+        auto touch = [&](std::size_t v, int d) {
+            const std::size_t s = static_cast<std::size_t>(a.slot[v]);
+            bump(roomUse[s * roomCount + a.room[v]], d);
+            bump(teacherUse[s * T + a.teacher[v]], d);
+            bump(groupUse[s * G + p.vars[v].group], d);
+        };
+        auto conflicted = [&](std::size_t v) {
+            const std::size_t s = static_cast<std::size_t>(a.slot[v]);
+            return roomUse[s * roomCount + a.room[v]] > 1 || teacherUse[s * T + a.teacher[v]] > 1 ||
+                   groupUse[s * G + p.vars[v].group] > 1;
+        };
+
+        // Найдешевше місце для v (v уже знято з лічильників). Рівні варіанти - випадково.
+        auto place = [&](std::size_t v, std::size_t step, bool noisy) {
+            const Var& var = p.vars[v];
+            std::int32_t bestCost = INT32_MAX, bestSlot = 0, bestRoom = 0, bestTeacher = 0;
+            std::size_t ties = 0;
+            const std::size_t firstSlot = noisy ? rng() % S : 0, lastSlot = noisy ? firstSlot + 1 : S;
+            for (std::size_t s = firstSlot; s < lastSlot; ++s) {
+                std::int32_t cost = groupUse[s * G + var.group];
+                std::int32_t room = var.rooms[0], roomCost = INT32_MAX;
+                for (std::int32_t r : var.rooms) {
+                    if (roomUse[s * roomCount + r] < roomCost) { roomCost = roomUse[s * roomCount + r]; room = r; }
+                    if (roomCost == 0) break;
+                }
+                std::int32_t teacher = var.teachers[0], teacherCost = INT32_MAX;
+                for (std::int32_t t : var.teachers) {
+                    if (teacherUse[s * T + t] < teacherCost) { teacherCost = teacherUse[s * T + t]; teacher = t; }
+                    if (teacherCost == 0) break;
+                }
+                cost += roomCost + teacherCost;
+                if (!noisy && cost > 0 && tabu[v * S + s] > step) continue; // свіжо покинутий слот
+                if (cost < bestCost) { bestCost = cost; ties = 0; }
+                if (cost == bestCost && rng() % ++ties == 0) {
+                    bestSlot = static_cast<std::int32_t>(s); bestRoom = room; bestTeacher = teacher;
+                }
+            }
+            if (bestCost == INT32_MAX) { // усе під табу - лишаємо на місці
+                touch(v, +1);
+                return;
+            }
+            a.slot[v] = bestSlot; a.room[v] = bestRoom; a.teacher[v] = bestTeacher;
+            touch(v, +1);
+        };
+
+        // Початкове жадібне розміщення: спершу закріплені, потім решта у випадковому порядку
+        std::vector<std::size_t> order;
+        for (std::size_t v = 0; v < n; ++v) {
+            if (p.vars[v].pinned) {
+                a.slot[v] = p.vars[v].slot; a.room[v] = p.vars[v].room; a.teacher[v] = p.vars[v].teacher;
+                touch(v, +1);
+            } else {
+                order.push_back(v);
+            }
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+        for (std::size_t v : order) {
+            a.slot[v] = 0; a.room[v] = p.vars[v].rooms[0]; a.teacher[v] = p.vars[v].teachers[0];
+            place(v, 0, false);
+        }
+
+        std::vector<std::size_t> candidates;
+        for (std::size_t step = 1; step <= maxSteps && violations > 0; ++step) {
+            if ((step & 255) == 0 && (stop.load(std::memory_order_relaxed) || std::chrono::steady_clock::now() >= deadline))
+                break;
+            candidates.clear();
+            for (std::size_t v : order) {
+                if (conflicted(v)) candidates.push_back(v);
+            }
+            if (candidates.empty()) break; // лишились конфлікти лише між закріпленими заняттями
+            const std::size_t v = candidates[rng() % candidates.size()];
+            touch(v, -1);
+            tabu[v * S + a.slot[v]] = step + 8 + rng() % 8;
+            place(v, step, rng() % 16 == 0);
+        }
+        a.violations = violations;
+        return a;
+    }
+
+    Assignment runParallel(const Problem& p, std::chrono::steady_clock::time_point deadline, std::size_t& restarts) const {
+        unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+        threads = std::max(1u, threads);
+
+        // Спільний лічильник спроб: вільний потік бере наступну, тож повільні спроби не гальмують інших
+        std::atomic<std::size_t> nextRestart{0};
+        std::atomic<bool> solved{false};
+        std::mutex bestMutex;
+        Assignment best;
+
+        // Викликаючий потік завжди проходить хоча б одну спробу, навіть якщо час уже вичерпано,
+        // тож результат завжди містить повне (можливо, конфліктне) розміщення
+        auto worker = [&](bool first) {
+            while (first || (!solved.load() && std::chrono::steady_clock::now() < deadline)) {
+                first = false;
+                const std::size_t restart = nextRestart.fetch_add(1);
+                Assignment a = search(p, rooms.size(), options.seed + 0x9E3779B97F4A7C15ull * restart,
+                                      options.stepsPerRestart, deadline, solved);
+                a.restart = restart;
+                std::lock_guard<std::mutex> lock(bestMutex);
+                if (a.violations < best.violations || (a.violations == best.violations && restart < best.restart))
+                    best = std::move(a);
+                if (best.violations == 0) solved = true;
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; ++i) pool.emplace_back(worker, false);
+        worker(true);
+        for (auto& t : pool) t.join();
+        restarts = nextRestart.load();
+        return best;
+    }
+
+    ScheduleResult makeResult(const std::vector<CourseRequest>& requests, const Problem& p, const Assignment& a) const {
+        ScheduleResult result;
+        if (a.slot.size() != p.vars.size()) { // жодна спроба не завершилась: нічого не розміщено
+            result.violations = p.vars.size();
+            return result;
+        }
+        result.violations = a.violations;
+        for (std::size_t v = 0; v < p.vars.size(); ++v) {
+            const CourseRequest& req = requests[v / 2];
+            const bool lecture = v % 2 == 0;
+            const auto& teacher = p.teacherPool[a.teacher[v]];
+            ScheduledSession s{req.group, req.courseName, lecture, a.slot[v], static_cast<std::size_t>(a.room[v]),
+                               teacher.get(), nullptr};
+            const std::string time = slotTime(s.slot);
+            s.session = lecture ? req.factory->createLecture(time, rooms[s.room].name, teacher)
+                                : req.factory->createPractical(time, rooms[s.room].name, teacher);
+            result.sessions.push_back(std::move(s));
+        }
+        return result;
+    }
+
+public:
+    AutoScheduler(std::vector<Room> r, std::vector<std::shared_ptr<Teacher>> s, SchedulerOptions opts = {})
+        : rooms(std::move(r)), staff(std::move(s)), options(opts) {
+        if (rooms.empty()) throw std::invalid_argument("AutoScheduler needs at least one room");
+        if (options.days < 1 || options.days > 7 || options.periodsPerDay < 1)
+            throw std::invalid_argument("AutoScheduler: bad days/periods");
+    }
+
+    // "Mon 08:30-09:50" для слоту з номером slot
+    std::string slotTime(int slot) const {
+        static const char* const days[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+        const int start = options.firstPeriodStart + (slot % options.periodsPerDay) * (options.periodMinutes + options.breakMinutes);
+        const int end = start + options.periodMinutes;
+        char buf[32];
+        std::snprintf(buf, sizeof buf, "%s %02d:%02d-%02d:%02d", days[slot / options.periodsPerDay],
+                      start / 60, start % 60, end / 60, end % 60);
+        return buf;
+    }
+
+    ScheduleResult solve(const std::vector<CourseRequest>& requests) const {
+        const auto started = std::chrono::steady_clock::now();
+        const Problem p = buildProblem(requests);
+        std::size_t restarts = 0;
+        // Бюджет - лише на пошук, а не на побудову задачі
+        const auto deadline = std::chrono::steady_clock::now() + options.timeBudget;
+        ScheduleResult result = makeResult(requests, p, runParallel(p, deadline, restarts));
+        result.restarts = restarts;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+
+    // Re-solves after one group's courses changed: every other group keeps the slot, room and
+    // teacher it had in `previous`, so only the changed group's sessions move. Falls back to a
+    // full solve if the pinned timetable leaves no room for them.
+    ScheduleResult resolve(const std::vector<CourseRequest>& requests, const ScheduleResult& previous,
+                           const StudentGroup* changed) const {
+        const auto started = std::chrono::steady_clock::now();
+        Problem p = buildProblem(requests);
+
+        std::unordered_map<std::string, const ScheduledSession*> old;
+        auto key = [](const StudentGroup* g, const std::string& course, bool lecture) {
+            return std::to_string(reinterpret_cast<std::uintptr_t>(g)) + '|' + course + (lecture ? "|L" : "|P");
+        };
+        for (const auto& s : previous.sessions) old.emplace(key(s.group, s.courseName, s.lecture), &s);
+
+        for (std::size_t v = 0; v < p.vars.size(); ++v) {
+            const CourseRequest& req = requests[v / 2];
+            if (req.group == changed) continue;
+            auto it = old.find(key(req.group, req.courseName, v % 2 == 0));
+            if (it == old.end()) continue;
+            Var& var = p.vars[v];
+            const auto room = std::find(var.rooms.begin(), var.rooms.end(), static_cast<std::int32_t>(it->second->room));
+            const auto teacher = std::find_if(var.teachers.begin(), var.teachers.end(), [&](std::int32_t t) {
+                return p.teacherPool[t].get() == it->second->teacher;
+            });
+            if (room == var.rooms.end() || teacher == var.teachers.end() || it->second->slot >= p.slots) continue;
+            var.pinned = true;
+            var.slot = it->second->slot;
+            var.room = *room;
+            var.teacher = *teacher;
+        }
+
+        std::size_t restarts = 0;
+        Assignment a = runParallel(p, std::chrono::steady_clock::now() + options.timeBudget, restarts);
+        if (a.violations > 0) {
+            for (auto& var : p.vars) var.pinned = false;
+            std::size_t more = 0;
+            Assignment full = runParallel(p, std::chrono::steady_clock::now() + options.timeBudget, more);
+            restarts += more;
+            if (full.violations < a.violations) a = std::move(full);
+        }
+        ScheduleResult result = makeResult(requests, p, a);
+        result.restarts = restarts;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+
+    // Adds the scheduled sessions to their groups (and through them to the groups' timetables).
+    static void apply(const ScheduleResult& result) {
+        for (const auto& s : result.sessions) s.group->addSession(s.session);
+    }
 };
 
 int main() {
@@ -381,6 +1098,50 @@ int main() {
     std::cout << group1->getSchedule();
     std::cout << group2->getSchedule();
     
+    std::cout << "\n\n🗓  Shared Timetable Demo (overlapping times):\n";
+    std::cout << "────────────────────────────────────────────────────\n";
+
+    auto university = std::make_shared<Timetable>();
+    StudentGroup groupA("FeP-23", university);
+    StudentGroup groupB("FeP-24", university);
+    groupA.addSession(progFactory->createLecture("Tue 09:00-10:30", "Auditorium 2", drSinkevych));
+    groupB.addSession(mathFactory->createLecture("Tue 10:00", "Auditorium 2", drKovalenko));
+    groupB.addSession(dbFactory->createPractical("Tue 10:15-11:00", "Lab 1", drKovalenko));
+    for (const auto& c : groupB.takeNewConflicts()) {
+        std::cout << "  ⚠️  " << describeConflictKinds(c.kinds) << ": "
+                  << c.first->getTime() << " " << c.first->getRoom() << " (" << c.firstGroup->getName() << ") vs "
+                  << c.second->getTime() << " " << c.second->getRoom() << " (" << c.secondGroup->getName() << ")\n";
+    }
+    std::cout << "  New conflicts since last check: " << groupB.takeNewConflicts().size() << "\n";
+
+    std::cout << "\n\n🤖 Auto-Scheduler Demo:\n";
+    std::cout << "────────────────────────────────────────────────────\n";
+
+    auto semester = std::make_shared<Timetable>();
+    auto group3 = std::make_shared<StudentGroup>("FeP-25", semester);
+    auto group4 = std::make_shared<StudentGroup>("FeP-26", semester);
+    for (const auto& g : {group3, group4}) {
+        g->addStudent("Student A");
+        g->addStudent("Student B");
+    }
+    std::vector<Room> rooms = {{"Auditorium 1", 120, true}, {"Lab 3", 20, false}, {"Lab 4", 20, false}};
+    std::vector<std::shared_ptr<Teacher>> staff = {drSinkevych, drKovalenko, drPetrenko, msShevchenko, mentor};
+    std::vector<CourseRequest> requests = {
+        {group3.get(), progFactory, "OOP in C++", drSinkevych, nullptr},
+        {group3.get(), dbFactory, "SQL & NoSQL", nullptr, nullptr},
+        {group4.get(), mathFactory, "Linear Algebra", drKovalenko, nullptr},
+        {group4.get(), progFactory, "Data Structures", nullptr, drPetrenko},
+    };
+    SchedulerOptions schedOptions;
+    schedOptions.days = 2;
+    schedOptions.periodsPerDay = 2; // тісний тиждень, щоб було видно розподіл
+    AutoScheduler scheduler(rooms, staff, schedOptions);
+    auto plan = scheduler.solve(requests);
+    std::cout << "Solved " << plan.sessions.size() << " sessions, " << plan.violations << " conflict(s), "
+              << plan.restarts << " restart(s)\n";
+    AutoScheduler::apply(plan);
+    std::cout << group3->getSchedule() << group4->getSchedule();
+
     std::cout << "\n\n🏭 Factory Method Pattern Demo:\n";
     std::cout << "────────────────────────────────────────────────────\n";
     
@@ -4,199 +4,2220 @@
 #include <unordered_map>
 #include <memory>
 #include <optional>
+#include <variant>
+#include <string_view>
 #include <algorithm>
 #include <stdexcept> // Для std::runtime_error
 #include <cctype>    // Для isdigit
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <initializer_list>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+#include <exception>
+#include <climits>
+#include <limits>
+#include <charconv>
+#include <typeinfo>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "../common/instrument.h"
 
 // ============================================================================
-// HIERARCHY OF DATA TYPES (STRATEGY PATTERN)
+// NATIVE VALUES
 // ============================================================================
 
-class DataType {
+// Розібране значення клітинки. std::monostate означає NULL; Date зберігається як
+// кількість днів від 1970-01-01.
+using CellValue = std::variant<std::monostate, int64_t, bool, int32_t, std::string>;
+
+inline bool isNull(const CellValue& v) { return std::holds_alternative<std::monostate>(v); }
+
+// Перетворення григоріанської дати у дні від епохи і назад (алгоритм Говарда Хіннанта).
+inline int32_t daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+inline std::string formatDate(int32_t days) {
+    const int z = days + 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    const int y = static_cast<int>(yoe) + era * 400 + (m <= 2);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%04d-%02u-%02u", y, m, d);
+    return buf;
+}
+
+// ============================================================================
+// COLUMNAR STORAGE
+// ============================================================================
+
+// Розмір фрагмента таблиці (для паралельних агрегатів і статистик фрагментів); кратний 64,
+// тож межі фрагментів збігаються з межами слів маски NULL.
+constexpr size_t kChunkRows = 64 * 1024;
+
+// Суцільний буфер значень колонки. Може або володіти пам'яттю (std::vector), або
+// посилатися на відображений у пам'ять знімок (mmap) без копіювання. Перша зміна
+// позиченого буфера копіює його у власну пам'ять (copy-on-write).
+template <typename T>
+class ColumnBuffer {
+private:
+    std::vector<T> owned;
+    const T* borrowed = nullptr;
+    size_t borrowedSize = 0;
+    std::shared_ptr<const void> keepAlive; // тримає відображення знімка, поки буфер його використовує
+
+    void detach() {
+        if (!borrowed) return;
+        owned.assign(borrowed, borrowed + borrowedSize);
+        borrowed = nullptr;
+        borrowedSize = 0;
+        keepAlive.reset();
+    }
 public:
-    virtual bool validate(const std::string& value) const = 0;
-    virtual std::string getName() const = 0;
-    virtual ~DataType() = default;
+    ColumnBuffer() = default;
+    ColumnBuffer(std::initializer_list<T> init) : owned(init) {}
+
+    static ColumnBuffer borrow(const T* data, size_t n, std::shared_ptr<const void> owner) {
+        ColumnBuffer buffer;
+        buffer.borrowed = data;
+        buffer.borrowedSize = n;
+        buffer.keepAlive = std::move(owner);
+        return buffer;
+    }
+
+    const T* data() const { return borrowed ? borrowed : owned.data(); }
+    size_t size() const { return borrowed ? borrowedSize : owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    void push_back(const T& v) {
+        detach();
+        owned.push_back(v);
+    }
+
+    void append(const T* p, size_t n) {
+        detach();
+        owned.insert(owned.end(), p, p + n);
+    }
+
+    T& back() {
+        detach();
+        return owned.back();
+    }
+
+    // Зростає геометрично, тож часті reserve(size() + 1) не перетворюються на
+    // перевиділення пам'яті при кожній вставці.
+    void reserve(size_t n) {
+        detach();
+        if (n > owned.capacity()) owned.reserve(std::max(n, owned.capacity() * 2));
+    }
 };
 
-class IntegerType : public DataType {
+// ============================================================================
+// SNAPSHOT FORMAT
+// ============================================================================
+
+// Бінарний знімок бази. Формат у порядку байтів машини (знімок читає той самий build):
+//   заголовок: "LAB4SNAP", u32 версія, u32 кількість таблиць, u64 LSN журналу (WAL),
+//              до якого включно знімок містить усі вставки
+//   таблиця:   рядок назви, u32 кількість колонок, u64 кількість рядків,
+//              схема колонок (назва, назва типу, nullable, pk, fk), далі дані колонок
+//   масив:     u64 кількість елементів, вирівняний на 64 байти блок елементів
+// Рядки (string) записуються як u32 довжина + байти. Масиви вирівняні, тож після mmap
+// сховища колонок посилаються на них напряму, без десеріалізації.
+constexpr char kSnapshotMagic[8] = {'L', 'A', 'B', '4', 'S', 'N', 'A', 'P'};
+constexpr uint32_t kSnapshotVersion = 3;
+
+class SnapshotWriter {
+private:
+    std::FILE* file;
+    uint64_t pos = 0;
+public:
+    explicit SnapshotWriter(std::FILE* f) : file(f) {}
+
+    void write(const void* data, size_t n) {
+        if (n && std::fwrite(data, 1, n, file) != n) throw std::runtime_error("Snapshot write failed");
+        pos += n;
+    }
+
+    template <typename T>
+    void writeValue(const T& v) { write(&v, sizeof(T)); }
+
+    void writeString(const std::string& s) {
+        writeValue(static_cast<uint32_t>(s.size()));
+        write(s.data(), s.size());
+    }
+
+    void align() {
+        static const char zeros[64] = {};
+        write(zeros, (64 - pos % 64) % 64);
+    }
+
+    template <typename T>
+    void writeArray(const ColumnBuffer<T>& buffer) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be trivially copyable");
+        writeValue(static_cast<uint64_t>(buffer.size()));
+        align();
+        write(buffer.data(), buffer.size() * sizeof(T));
+    }
+};
+
+class SnapshotReader {
+private:
+    const char* base;
+    size_t length;
+    size_t pos = 0;
+    std::shared_ptr<const void> mapping;
+
+    void need(size_t n) const {
+        if (n > length - pos) throw std::runtime_error("Corrupt snapshot: unexpected end of file");
+    }
+public:
+    SnapshotReader(const char* data, size_t n, std::shared_ptr<const void> owner)
+        : base(data), length(n), mapping(std::move(owner)) {}
+
+    template <typename T>
+    T readValue() {
+        need(sizeof(T));
+        T v;
+        std::memcpy(&v, base + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+
+    std::string readString() {
+        const uint32_t n = readValue<uint32_t>();
+        need(n);
+        std::string s(base + pos, n);
+        pos += n;
+        return s;
+    }
+
+    void align() {
+        const size_t pad = (64 - pos % 64) % 64;
+        need(pad);
+        pos += pad;
+    }
+
+    // Масив не копіюється: буфер посилається на відображену пам'ять знімка.
+    template <typename T>
+    ColumnBuffer<T> readArray() {
+        const uint64_t n = readValue<uint64_t>();
+        align();
+        if (n > (length - pos) / sizeof(T)) throw std::runtime_error("Corrupt snapshot: array out of bounds");
+        auto buffer = ColumnBuffer<T>::borrow(reinterpret_cast<const T*>(base + pos), n, mapping);
+        pos += n * sizeof(T);
+        return buffer;
+    }
+};
+
+// Файл знімка, відображений у пам'ять лише для читання. Сторінки підвантажуються ОС
+// ліниво, при першому доступі до відповідних колонок.
+class MappedFile {
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open snapshot '" + path + "': " + std::strerror(errno));
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Snapshot '" + path + "' is empty or unreadable");
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("Cannot mmap snapshot '" + path + "': " + std::strerror(errno));
+        base = static_cast<const char*>(p);
+    }
+
+    ~MappedFile() {
+        if (base) ::munmap(const_cast<char*>(base), length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+// ============================================================================
+// COLUMN STORAGE CLASSES
+// ============================================================================
+
+// Щільний бітовий вектор. Використовується як маска присутності значень (біт i = 1,
+// якщо в рядку i є значення) і як сховище для Boolean-колонок.
+class BitVector {
+private:
+    ColumnBuffer<uint64_t> words;
+    size_t bits = 0;
+public:
+    void push(bool bit) {
+        if (bits % 64 == 0) words.push_back(0);
+        if (bit) words.back() |= uint64_t(1) << (bits % 64);
+        ++bits;
+    }
+
+    bool test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+    void reserve(size_t n) { words.reserve((n + 63) / 64); }
+
+    size_t countSet() const {
+        size_t c = 0;
+        for (uint64_t w : words) c += __builtin_popcountll(w);
+        return c;
+    }
+
+    size_t size() const { return bits; }
+    const ColumnBuffer<uint64_t>& getWords() const { return words; }
+
+    void writeTo(SnapshotWriter& out) const {
+        out.writeValue(static_cast<uint64_t>(bits));
+        out.writeArray(words);
+    }
+
+    void readFrom(SnapshotReader& in) {
+        bits = in.readValue<uint64_t>();
+        words = in.readArray<uint64_t>();
+        if (words.size() != (bits + 63) / 64) throw std::runtime_error("Corrupt snapshot: bitmap size mismatch");
+    }
+};
+
+// Сховище однієї колонки: суцільний типізований вектор значень плюс маска NULL.
+// Для NULL-рядків у вектор значень кладеться значення за замовчуванням, тож індекс
+// у векторі завжди збігається з номером рядка.
+class ColumnStorage {
+protected:
+    BitVector validity;
+public:
+    virtual ~ColumnStorage() = default;
+    // Значення вже розібране типом колонки (DataType::parse); monostate означає NULL.
+    virtual void append(const CellValue& value) = 0;
+    virtual CellValue get(size_t row) const = 0;
+    virtual std::string getString(size_t row) const = 0;
+    virtual void reserve(size_t rows) { validity.reserve(rows); }
+
+    // Запис у знімок і відновлення з нього (readFrom не копіює дані, а посилається на mmap).
+    virtual void writeTo(SnapshotWriter& out) const { validity.writeTo(out); }
+    virtual void readFrom(SnapshotReader& in) { validity.readFrom(in); }
+
+    size_t size() const { return validity.size(); }
+    bool isNull(size_t row) const { return !validity.test(row); }
+    size_t countNonNull() const { return validity.countSet(); }
+    const BitVector& getValidity() const { return validity; }
+};
+
+// Статистика фрагмента (zone map): дозволяє фільтрованим агрегатам пропускати фрагменти,
+// у яких жоден рядок не може задовольнити умову.
+template <typename T>
+struct ZoneStats {
+    T min = std::numeric_limits<T>::max();
+    T max = std::numeric_limits<T>::lowest();
+    uint32_t nullCount = 0;
+    uint32_t rows = 0;
+
+    bool allNull() const { return nullCount == rows; }
+};
+
+template <typename T>
+class FixedWidthColumnStorage : public ColumnStorage {
+protected:
+    ColumnBuffer<T> values;
+    ColumnBuffer<ZoneStats<T>> zones; // zones[i] описує рядки [i * kChunkRows, (i + 1) * kChunkRows)
+public:
+    void append(const CellValue& value) override {
+        const bool present = !::isNull(value);
+        if (size() % kChunkRows == 0) zones.push_back(ZoneStats<T>());
+        ZoneStats<T>& zone = zones.back();
+        ++zone.rows;
+        if (present) {
+            const T v = std::get<T>(value);
+            zone.min = std::min(zone.min, v);
+            zone.max = std::max(zone.max, v);
+        } else {
+            ++zone.nullCount;
+        }
+        validity.push(present);
+        values.push_back(present ? std::get<T>(value) : T{});
+    }
+
+    const ColumnBuffer<ZoneStats<T>>& getZones() const { return zones; }
+
+    CellValue get(size_t row) const override {
+        if (isNull(row)) return std::monostate{};
+        return values[row];
+    }
+
+    void reserve(size_t rows) override {
+        ColumnStorage::reserve(rows);
+        values.reserve(rows);
+    }
+
+    void writeTo(SnapshotWriter& out) const override {
+        ColumnStorage::writeTo(out);
+        out.writeArray(values);
+        out.writeArray(zones);
+    }
+
+    void readFrom(SnapshotReader& in) override {
+        ColumnStorage::readFrom(in);
+        values = in.readArray<T>();
+        zones = in.readArray<ZoneStats<T>>();
+        if (values.size() != size() || zones.size() != (size() + kChunkRows - 1) / kChunkRows) {
+            throw std::runtime_error("Corrupt snapshot: column size mismatch");
+        }
+    }
+
+    const ColumnBuffer<T>& getValues() const { return values; }
+};
+
+class IntegerColumnStorage : public FixedWidthColumnStorage<int64_t> {
+public:
+    std::string getString(size_t row) const override {
+        return isNull(row) ? std::string() : std::to_string(values[row]);
+    }
+};
+
+class DateColumnStorage : public FixedWidthColumnStorage<int32_t> {
+public:
+    std::string getString(size_t row) const override {
+        return isNull(row) ? std::string() : formatDate(values[row]);
+    }
+};
+
+// Boolean-значення займають один біт на рядок.
+class BooleanColumnStorage : public ColumnStorage {
+private:
+    BitVector values;
+public:
+    void append(const CellValue& value) override {
+        const bool present = !::isNull(value);
+        validity.push(present);
+        values.push(present && std::get<bool>(value));
+    }
+
+    CellValue get(size_t row) const override {
+        if (isNull(row)) return std::monostate{};
+        return values.test(row);
+    }
+
+    std::string getString(size_t row) const override {
+        if (isNull(row)) return std::string();
+        return values.test(row) ? "true" : "false";
+    }
+
+    void reserve(size_t rows) override {
+        ColumnStorage::reserve(rows);
+        values.reserve(rows);
+    }
+
+    void writeTo(SnapshotWriter& out) const override {
+        ColumnStorage::writeTo(out);
+        values.writeTo(out);
+    }
+
+    void readFrom(SnapshotReader& in) override {
+        ColumnStorage::readFrom(in);
+        values.readFrom(in);
+        if (values.size() != size()) throw std::runtime_error("Corrupt snapshot: column size mismatch");
+    }
+
+    const BitVector& getValues() const { return values; }
+};
+
+enum class StringEncoding {
+    Auto,       // словник, поки кількість різних значень не перевищить kDictionaryMaxDistinct
+    Plain,      // завжди зберігати значення кожного рядка
+    Dictionary  // завжди словник
+};
+
+// Поріг різних значень, до якого Auto-колонка лишається словниковою.
+constexpr size_t kDictionaryMaxDistinct = 1 << 16;
+
+// Рядки зберігаються без окремої алокації на клітинку: усі байти йдуть підряд,
+// а offsets[i]..offsets[i + 1] задає межі i-го значення.
+// У словниковому кодуванні offsets/bytes містять лише різні значення (пул рядків), а
+// кожен рядок таблиці зберігає u32-код значення в пулі. Фільтри на рівність і count
+// тоді працюють з кодами, не торкаючись байтів.
+// Після завантаження зі знімка коди не перевіряються наперед: межу коду перевіряє
+// кожне звернення до пулу, а хеш значення -> код будується при першій вставці чи фільтрі.
+class StringColumnStorage : public ColumnStorage {
+private:
+    StringEncoding encoding;
+    bool dictionary;
+    ColumnBuffer<uint64_t> offsets{0};
+    ColumnBuffer<char> bytes;
+    ColumnBuffer<uint32_t> codes;
+    mutable std::unordered_map<std::string, uint32_t> lookup; // значення -> код
+    mutable std::atomic<bool> lookupReady{true};
+    mutable std::mutex lookupBuild;
+
+    std::string_view pooled(size_t i) const {
+        return std::string_view(bytes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    std::string_view pooledCode(uint32_t code) const {
+        if (code >= offsets.size() - 1) throw std::runtime_error("Corrupt snapshot: dictionary code out of range");
+        return pooled(code);
+    }
+
+    void appendBytes(const std::string& s) {
+        bytes.append(s.data(), s.size());
+        offsets.push_back(bytes.size());
+    }
+
+    // Кількість різних значень перевищила поріг: переходимо на звичайне зберігання.
+    void convertToPlain() {
+        ColumnBuffer<uint64_t> plainOffsets{0};
+        ColumnBuffer<char> plainBytes;
+        plainOffsets.reserve(size() + 1);
+        for (size_t r = 0; r < size(); ++r) {
+            if (!isNull(r)) {
+                const auto v = pooledCode(codes[r]);
+                plainBytes.append(v.data(), v.size());
+            }
+            plainOffsets.push_back(plainBytes.size());
+        }
+        offsets = std::move(plainOffsets);
+        bytes = std::move(plainBytes);
+        codes = ColumnBuffer<uint32_t>();
+        lookup.clear();
+        dictionary = false;
+    }
+
+    void ensureLookup() const {
+        if (lookupReady.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> guard(lookupBuild);
+        if (lookupReady.load(std::memory_order_relaxed)) return;
+        const size_t distinct = offsets.size() - 1;
+        lookup.reserve(distinct);
+        for (size_t i = 0; i < distinct; ++i) lookup.emplace(std::string(pooled(i)), static_cast<uint32_t>(i));
+        lookupReady.store(true, std::memory_order_release);
+    }
 public:
-    bool validate(const std::string& value) const override {
-        if (value.empty()) return false;
+    explicit StringColumnStorage(StringEncoding e = StringEncoding::Auto)
+        : encoding(e), dictionary(e != StringEncoding::Plain) {}
+
+    void append(const CellValue& value) override {
+        const bool present = !::isNull(value);
+        if (dictionary && present) {
+            const auto& s = std::get<std::string>(value);
+            ensureLookup();
+            auto it = lookup.find(s);
+            if (it == lookup.end() && encoding == StringEncoding::Auto && lookup.size() >= kDictionaryMaxDistinct) {
+                convertToPlain();
+            } else {
+                if (it == lookup.end()) {
+                    it = lookup.emplace(s, static_cast<uint32_t>(lookup.size())).first;
+                    appendBytes(s);
+                }
+                validity.push(true);
+                codes.push_back(it->second);
+                return;
+            }
+        }
+        validity.push(present);
+        if (dictionary) {
+            codes.push_back(0);
+        } else {
+            if (present) {
+                const auto& s = std::get<std::string>(value);
+                bytes.append(s.data(), s.size());
+            }
+            offsets.push_back(bytes.size());
+        }
+    }
+
+    CellValue get(size_t row) const override {
+        if (isNull(row)) return std::monostate{};
+        return getString(row);
+    }
+
+    std::string getString(size_t row) const override {
+        if (dictionary) return isNull(row) ? std::string() : std::string(pooledCode(codes[row]));
+        return std::string(pooled(row));
+    }
+
+    // Порівняння без копіювання значення у std::string.
+    bool equals(size_t row, std::string_view value) const {
+        if (isNull(row)) return false;
+        return (dictionary ? pooledCode(codes[row]) : pooled(row)) == value;
+    }
+
+    void reserve(size_t rows) override {
+        ColumnStorage::reserve(rows);
+        if (dictionary) codes.reserve(rows);
+        else offsets.reserve(rows + 1);
+    }
+
+    bool isDictionaryEncoded() const { return dictionary; }
+    const ColumnBuffer<uint32_t>& getCodes() const { return codes; }
+    size_t distinctCount() const { return dictionary ? offsets.size() - 1 : 0; }
+    std::string getDictionaryValue(uint32_t code) const { return std::string(pooledCode(code)); }
+
+    std::optional<uint32_t> findCode(const std::string& value) const {
+        ensureLookup();
+        auto it = lookup.find(value);
+        if (it == lookup.end()) return std::nullopt;
+        return it->second;
+    }
+
+    void writeTo(SnapshotWriter& out) const override {
+        ColumnStorage::writeTo(out);
+        out.writeValue(static_cast<uint8_t>(encoding));
+        out.writeValue(static_cast<uint8_t>(dictionary));
+        out.writeArray(offsets);
+        out.writeArray(bytes);
+        if (dictionary) out.writeArray(codes);
+    }
+
+    void readFrom(SnapshotReader& in) override {
+        ColumnStorage::readFrom(in);
+        const uint8_t storedEncoding = in.readValue<uint8_t>();
+        if (storedEncoding > static_cast<uint8_t>(StringEncoding::Dictionary)) {
+            throw std::runtime_error("Corrupt snapshot: unknown string encoding " + std::to_string(storedEncoding));
+        }
+        encoding = static_cast<StringEncoding>(storedEncoding);
+        dictionary = in.readValue<uint8_t>() != 0;
+        if (dictionary && encoding == StringEncoding::Plain) {
+            throw std::runtime_error("Corrupt snapshot: plain string column stored as dictionary");
+        }
+        offsets = in.readArray<uint64_t>();
+        bytes = in.readArray<char>();
+        if (offsets.empty() || offsets[offsets.size() - 1] != bytes.size()) {
+            throw std::runtime_error("Corrupt snapshot: string column size mismatch");
+        }
+        if (dictionary) {
+            codes = in.readArray<uint32_t>();
+            if (codes.size() != size()) throw std::runtime_error("Corrupt snapshot: string column size mismatch");
+            lookup.clear();
+            lookupReady.store(false, std::memory_order_release);
+        } else if (offsets.size() != size() + 1) {
+            throw std::runtime_error("Corrupt snapshot: string column size mismatch");
+        }
+    }
+};
+
+// ============================================================================
+// AGGREGATE KERNELS (SIMD + RUNTIME DISPATCH)
+// ============================================================================
+
+// Результат одного проходу по Integer-колонці: усі агрегати рахуються разом,
+// тож avg/min/max не потребують повторного сканування.
+struct IntAggregate {
+    int64_t count = 0;
+    int64_t sum = 0;
+    int64_t min = INT64_MAX;
+    int64_t max = INT64_MIN;
+
+    // Сума накопичується в int64, тож об'єднання часткових результатів точне і не
+    // залежить від порядку чи кількості потоків.
+    void merge(const IntAggregate& other) {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+enum class AggregateKind { Count, Sum, Avg, Min, Max };
+
+// Агрегат для groupBy: яку функцію рахувати і над якою колонкою.
+struct Aggregate {
+    AggregateKind kind;
+    std::string column;
+};
+
+// Умова low <= column <= high для Integer- або Date-колонки. Межі задаються так само, як
+// значення при вставці (напр., "2024-01-01"); порожня межа означає відсутність обмеження.
+// Рядки з NULL у колонці умові не задовольняють.
+struct RangePredicate {
+    std::string column;
+    std::string low;
+    std::string high;
+};
+
+// Умова column == value. Для String-колонки у словниковому кодуванні значення один раз
+// перекладається у код і далі порівнюються лише коди; для Integer/Date це діапазон value..value.
+struct EqualsPredicate {
+    std::string column;
+    std::string value;
+};
+
+struct GroupResult {
+    std::string key;   // "NULL" для групи рядків без значення
+    std::optional<double> value; // nullopt: AVG/MIN/MAX групи, де всі значення NULL (як в aggregateWhere)
+};
+
+namespace kernels {
+
+// Ядра не розгалужуються на кожному рядку: значення поєднується з бітом маски NULL.
+// Біти маски за межами n завжди нульові (BitVector їх не виставляє).
+using AggregateFn = IntAggregate (*)(const int64_t* values, const uint64_t* validity, size_t n);
+
+inline void accumulateScalar(IntAggregate& r, const int64_t* values, const uint64_t* validity,
+                             size_t from, size_t to) {
+    for (size_t i = from; i < to; ++i) {
+        const int64_t bit = (validity[i / 64] >> (i % 64)) & 1;
+        const int64_t m = -bit;
+        const int64_t v = values[i];
+        r.count += bit;
+        r.sum += v & m;
+        r.min = std::min(r.min, (v & m) | (INT64_MAX & ~m));
+        r.max = std::max(r.max, (v & m) | (INT64_MIN & ~m));
+    }
+}
+
+inline IntAggregate aggregateScalar(const int64_t* values, const uint64_t* validity, size_t n) {
+    IntAggregate r;
+    accumulateScalar(r, values, validity, 0, n);
+    return r;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LAB4_HAVE_X86_KERNELS 1
+
+__attribute__((target("avx2")))
+inline IntAggregate aggregateAvx2(const int64_t* values, const uint64_t* validity, size_t n) {
+    IntAggregate r;
+    const size_t fullWords = n / 64;
+    const __m256i lane = _mm256_set_epi64x(8, 4, 2, 1);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i mn = _mm256_set1_epi64x(INT64_MAX);
+    __m256i mx = _mm256_set1_epi64x(INT64_MIN);
+    for (size_t w = 0; w < fullWords; ++w) {
+        const uint64_t bits = validity[w];
+        r.count += __builtin_popcountll(bits);
+        const int64_t* base = values + w * 64;
+        for (int g = 0; g < 16; ++g) {
+            // 4 біти маски -> 4 повні 64-бітні маски лінійок
+            const __m256i b = _mm256_set1_epi64x(static_cast<int64_t>(bits >> (4 * g)));
+            const __m256i m = _mm256_cmpeq_epi64(_mm256_and_si256(b, lane), lane);
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + 4 * g));
+            sum = _mm256_add_epi64(sum, _mm256_and_si256(v, m));
+            const __m256i forMin = _mm256_blendv_epi8(_mm256_set1_epi64x(INT64_MAX), v, m);
+            const __m256i forMax = _mm256_blendv_epi8(_mm256_set1_epi64x(INT64_MIN), v, m);
+            mn = _mm256_blendv_epi8(mn, forMin, _mm256_cmpgt_epi64(mn, forMin));
+            mx = _mm256_blendv_epi8(mx, forMax, _mm256_cmpgt_epi64(forMax, mx));
+        }
+    }
+    alignas(32) int64_t s[4], lo[4], hi[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s), sum);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lo), mn);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(hi), mx);
+    for (int i = 0; i < 4; ++i) {
+        r.sum += s[i];
+        r.min = std::min(r.min, lo[i]);
+        r.max = std::max(r.max, hi[i]);
+    }
+    accumulateScalar(r, values, validity, fullWords * 64, n);
+    return r;
+}
+
+__attribute__((target("avx512f")))
+inline IntAggregate aggregateAvx512(const int64_t* values, const uint64_t* validity, size_t n) {
+    IntAggregate r;
+    const size_t fullWords = n / 64;
+    __m512i sum = _mm512_setzero_si512();
+    __m512i mn = _mm512_set1_epi64(INT64_MAX);
+    __m512i mx = _mm512_set1_epi64(INT64_MIN);
+    for (size_t w = 0; w < fullWords; ++w) {
+        const uint64_t bits = validity[w];
+        r.count += __builtin_popcountll(bits);
+        const int64_t* base = values + w * 64;
+        for (int g = 0; g < 8; ++g) {
+            const __mmask8 k = static_cast<__mmask8>(bits >> (8 * g));
+            const __m512i v = _mm512_loadu_si512(base + 8 * g);
+            sum = _mm512_mask_add_epi64(sum, k, sum, v);
+            mn = _mm512_mask_min_epi64(mn, k, mn, v);
+            mx = _mm512_mask_max_epi64(mx, k, mx, v);
+        }
+    }
+    alignas(64) int64_t s[8], lo[8], hi[8];
+    _mm512_store_si512(s, sum);
+    _mm512_store_si512(lo, mn);
+    _mm512_store_si512(hi, mx);
+    for (int i = 0; i < 8; ++i) {
+        r.sum += s[i];
+        r.min = std::min(r.min, lo[i]);
+        r.max = std::max(r.max, hi[i]);
+    }
+    accumulateScalar(r, values, validity, fullWords * 64, n);
+    return r;
+}
+#endif
+
+// Вибір ядра за можливостями процесора робиться один раз при першому виклику.
+inline AggregateFn selectAggregateKernel() {
+#ifdef LAB4_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return aggregateAvx512;
+    if (__builtin_cpu_supports("avx2")) return aggregateAvx2;
+#endif
+    return aggregateScalar;
+}
+
+inline IntAggregate aggregate(const int64_t* values, const uint64_t* validity, size_t n) {
+    static const AggregateFn fn = selectAggregateKernel();
+    return fn(values, validity, n);
+}
+
+} // namespace kernels
+
+// ============================================================================
+// PARALLEL EXECUTION (WORK-STEALING THREAD POOL)
+// ============================================================================
+
+// Кожен робочий потік має власну чергу. Потік бере задачі з початку своєї черги, а
+// коли вона порожня — "краде" з кінця чужої. Потік, що викликав parallelFor, теж
+// виконує задачі, тож вкладені виклики не блокують пул.
+class WorkStealingPool {
+private:
+    struct TaskGroup {
+        std::atomic<size_t> remaining{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        const std::function<void(size_t)>* body;
+        size_t index;
+        TaskGroup* group;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+
+    bool popOwn(size_t q, Task& out) {
+        auto& queue = *queues[q];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        out = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(size_t thief, Task& out) {
+        for (size_t k = 1; k <= queues.size(); ++k) {
+            auto& queue = *queues[(thief + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            out = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    static void run(const Task& task) {
         try {
-            size_t pos;
-            std::stoi(value, &pos);
-            // Переконуємося, що *весь* рядок є числом, а не лише його початок (напр., "123xyz")
-            return pos == value.size();
-        } catch (const std::exception&) {
-            return false;
+            (*task.body)(task.index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(task.group->errorMutex);
+            if (!task.group->error) task.group->error = std::current_exception();
+        }
+        task.group->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    bool tryRunOne(size_t q) {
+        Task task;
+        if (!popOwn(q, task) && !steal(q, task)) return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        run(task);
+        return true;
+    }
+
+    void workerLoop(size_t q) {
+        while (!stopping) {
+            if (tryRunOne(q)) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [&] { return stopping || queued.load() > 0; });
+        }
+    }
+public:
+    // threads — кількість робочих потоків; потік-викликач завжди допомагає виконувати задачі.
+    explicit WorkStealingPool(size_t threadCount) {
+        for (size_t i = 0; i <= threadCount; ++i) queues.push_back(std::make_unique<WorkerQueue>());
+        for (size_t i = 0; i < threadCount; ++i) threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    static WorkStealingPool& instance() {
+        static WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    size_t concurrency() const { return threads.size() + 1; }
+
+    // Виконує body(0..n-1) і повертається, коли всі виклики завершені. Перший виняток
+    // з body прокидається викликачу.
+    void parallelFor(size_t n, const std::function<void(size_t)>& body) {
+        if (n == 0) return;
+        if (n == 1 || threads.empty()) {
+            for (size_t i = 0; i < n; ++i) body(i);
+            return;
+        }
+
+        TaskGroup group;
+        group.remaining = n;
+        // Роздаємо задачі суцільними блоками, щоб сусідні фрагменти обробляв один потік.
+        const size_t perQueue = (n + queues.size() - 1) / queues.size();
+        for (size_t q = 0; q < queues.size(); ++q) {
+            const size_t begin = q * perQueue;
+            const size_t end = std::min(n, begin + perQueue);
+            if (begin >= end) break;
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            for (size_t i = begin; i < end; ++i) queues[q]->tasks.push_back({&body, i, &group});
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued += n;
+        }
+        wakeUp.notify_all();
+
+        // Черга з номером threads.size() належить викликачу.
+        while (group.remaining.load(std::memory_order_acquire) > 0) {
+            if (!tryRunOne(threads.size())) std::this_thread::yield();
+        }
+        if (group.error) std::rethrow_exception(group.error);
+    }
+};
+
+// ============================================================================
+// VALUE PARSERS
+// ============================================================================
+
+// Розбір значень вбудованих типів без винятків і без копіювання у std::string.
+// Колонка вбудованого типу отримує вказівник на спеціалізацію parse<K> під час
+// TableBuilder::build і більше не ходить через віртуальний DataType::parse.
+namespace validators {
+
+enum class ValueKind { Integer, String, Boolean, Date };
+
+using ParseFn = std::optional<CellValue> (*)(std::string_view value);
+
+// Як і std::stoll раніше: дозволені пробіли на початку та '+' перед числом,
+// але не зайві символи після нього (напр., "123xyz").
+inline std::optional<CellValue> parseInteger(std::string_view value) {
+    size_t start = 0;
+    while (start < value.size() && std::isspace(static_cast<unsigned char>(value[start]))) ++start;
+    if (start + 1 < value.size() && value[start] == '+' && value[start + 1] != '-') ++start;
+    const char* first = value.data() + start;
+    const char* last = value.data() + value.size();
+    int64_t v = 0;
+    auto [ptr, ec] = std::from_chars(first, last, v);
+    if (ec != std::errc() || ptr != last || first == last) return std::nullopt;
+    return CellValue{v};
+}
+
+inline std::optional<CellValue> parseBoolean(std::string_view value) {
+    if (value == "true" || value == "1") return CellValue{true};
+    if (value == "false" || value == "0") return CellValue{false};
+    return std::nullopt;
+}
+
+// Формат YYYY-MM-DD з перевіркою коректності дати (місяць <= 12, день у межах місяця,
+// високосні роки).
+inline std::optional<CellValue> parseDate(std::string_view value) {
+    if (value.size() != 10) return std::nullopt;
+    if (value[4] != '-' || value[7] != '-') return std::nullopt;
+
+    for (int i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+        if (!isdigit(static_cast<unsigned char>(value[i]))) return std::nullopt;
+    }
+    auto digits = [&](int from, int len) {
+        int v = 0;
+        for (int i = from; i < from + len; ++i) v = v * 10 + (value[i] - '0');
+        return v;
+    };
+    const int y = digits(0, 4);
+    const int m = digits(5, 2);
+    const int d = digits(8, 2);
+    static const int monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (m < 1 || m > 12 || d < 1) return std::nullopt;
+    const bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    if (d > monthDays[m - 1] + (m == 2 && leap)) return std::nullopt;
+    return CellValue{daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d))};
+}
+
+template <ValueKind K>
+std::optional<CellValue> parse(std::string_view value) {
+    if constexpr (K == ValueKind::Integer) return parseInteger(value);
+    else if constexpr (K == ValueKind::Boolean) return parseBoolean(value);
+    else if constexpr (K == ValueKind::Date) return parseDate(value);
+    else return CellValue{std::string(value)};
+}
+
+} // namespace validators
+
+// ============================================================================
+// HIERARCHY OF DATA TYPES (STRATEGY PATTERN)
+// ============================================================================
+
+class DataType {
+public:
+    virtual bool validate(const std::string& value) const = 0;
+    virtual std::string getName() const = 0;
+    // Розбирає непорожнє значення у нативне представлення, яке й потрапляє у сховище.
+    // За замовчуванням значення зберігається як рядок; типи, що перевизначають
+    // createStorage(), мають перевизначити і parse() з відповідним типом значення.
+    virtual std::optional<CellValue> parse(const std::string& value) const {
+        if (!validate(value)) return std::nullopt;
+        return CellValue{value};
+    }
+    // Фабричний метод: який тип сховища використовувати для колонок цього типу.
+    virtual std::unique_ptr<ColumnStorage> createStorage() const {
+        return std::make_unique<StringColumnStorage>();
+    }
+    virtual ~DataType() = default;
+};
+
+class IntegerType : public DataType {
+public:
+    bool validate(const std::string& value) const override { return parse(value).has_value(); }
+
+    std::optional<CellValue> parse(const std::string& value) const override {
+        return validators::parseInteger(value);
+    }
+    std::string getName() const override { return "Integer"; }
+    std::unique_ptr<ColumnStorage> createStorage() const override {
+        return std::make_unique<IntegerColumnStorage>();
+    }
+};
+
+class StringType : public DataType {
+private:
+    StringEncoding encoding;
+public:
+    explicit StringType(StringEncoding e = StringEncoding::Auto) : encoding(e) {}
+
+    bool validate(const std::string& value) const override { return true; }
+    std::string getName() const override { return "String"; }
+    std::unique_ptr<ColumnStorage> createStorage() const override {
+        return std::make_unique<StringColumnStorage>(encoding);
+    }
+};
+
+class BooleanType : public DataType {
+public:
+    bool validate(const std::string& value) const override { return parse(value).has_value(); }
+
+    std::optional<CellValue> parse(const std::string& value) const override {
+        return validators::parseBoolean(value);
+    }
+    std::string getName() const override { return "Boolean"; }
+    std::unique_ptr<ColumnStorage> createStorage() const override {
+        return std::make_unique<BooleanColumnStorage>();
+    }
+};
+
+class DateType : public DataType {
+public:
+    bool validate(const std::string& value) const override { return parse(value).has_value(); }
+
+    std::optional<CellValue> parse(const std::string& value) const override {
+        return validators::parseDate(value);
+    }
+    std::string getName() const override { return "Date"; }
+    std::unique_ptr<ColumnStorage> createStorage() const override {
+        return std::make_unique<DateColumnStorage>();
+    }
+};
+
+namespace validators {
+
+// Спеціалізований розбирач лише для точно вбудованих типів: нащадок IntegerType
+// з власним parse() лишається на віртуальному шляху.
+inline ParseFn select(const DataType& type) {
+    const std::type_info& t = typeid(type);
+    if (t == typeid(IntegerType)) return &parse<ValueKind::Integer>;
+    if (t == typeid(StringType)) return &parse<ValueKind::String>;
+    if (t == typeid(BooleanType)) return &parse<ValueKind::Boolean>;
+    if (t == typeid(DateType)) return &parse<ValueKind::Date>;
+    return nullptr;
+}
+
+} // namespace validators
+
+// Відновлення вбудованих типів за назвою (для завантаження знімка).
+inline std::shared_ptr<DataType> createBuiltinType(const std::string& typeName) {
+    if (typeName == "Integer") return std::make_shared<IntegerType>();
+    if (typeName == "String") return std::make_shared<StringType>();
+    if (typeName == "Boolean") return std::make_shared<BooleanType>();
+    if (typeName == "Date") return std::make_shared<DateType>();
+    throw std::runtime_error("Snapshot references unknown data type '" + typeName + "'");
+}
+
+// ============================================================================
+// DATABASE CORE CLASSES
+// ============================================================================
+
+class Column {
+private:
+    std::string name;
+    std::shared_ptr<DataType> type;
+    bool nullable;
+    bool primaryKey;
+    std::optional<std::pair<std::string, std::string>> foreignKey;
+    validators::ParseFn fastParse = nullptr; // nullptr — розбір через type->parse
+public:
+    Column(const std::string& n, std::shared_ptr<DataType> t, bool nullb = true, bool pk = false,
+           std::optional<std::pair<std::string, std::string>> fk = std::nullopt)
+        : name(n), type(std::move(t)), nullable(nullb), primaryKey(pk), foreignKey(std::move(fk)) {}
+
+    // Обирає спеціалізований розбирач для вбудованого типу колонки.
+    void specialize() { fastParse = validators::select(*type); }
+
+    bool validate(std::string_view value) const {
+        if (value.empty()) {
+            // Порожнє значення припустиме, лише якщо колонка nullable
+            return nullable;
+        }
+        return fastParse ? fastParse(value).has_value() : type->validate(std::string(value));
+    }
+
+    // Валідує і одразу розбирає значення: nullopt, якщо значення некоректне,
+    // CellValue з monostate для дозволеного NULL.
+    std::optional<CellValue> parse(std::string_view value) const {
+        if (value.empty()) {
+            if (!nullable) return std::nullopt;
+            return CellValue{};
+        }
+        if (fastParse) return fastParse(value);
+        return type->parse(std::string(value));
+    }
+
+    std::string getName() const { return name; }
+    std::shared_ptr<DataType> getType() const { return type; }
+    bool isPrimaryKey() const { return primaryKey; }
+    bool isNullable() const { return nullable; }
+    std::optional<std::pair<std::string, std::string>> getForeignKey() const { return foreignKey; }
+};
+
+class Row {
+private:
+    std::unordered_map<std::string, std::string> data;
+public:
+    Row() = default;
+    explicit Row(std::unordered_map<std::string, std::string> d) : data(std::move(d)) {}
+    const std::unordered_map<std::string, std::string>& getData() const { return data; }
+};
+
+// Пакет рядків для масової вставки у column-major вигляді. Усі значення лежать в
+// одному буфері, а кожна клітинка — це лише межі в ньому, тож побудова пакета не
+// алокує пам'ять на кожне значення. Порожнє значення означає NULL.
+class RowBatch {
+private:
+    struct Cell {
+        size_t offset;
+        size_t length;
+    };
+
+    std::vector<std::string> columnNames;
+    std::unordered_map<std::string, size_t> columnIndex;
+    std::string buffer;
+    std::vector<std::vector<Cell>> cells; // cells[колонка][рядок]
+    size_t rows = 0;
+    std::vector<std::pair<size_t, std::string>> malformedRows;
+public:
+    explicit RowBatch(std::vector<std::string> names) : columnNames(std::move(names)), cells(columnNames.size()) {
+        for (size_t i = 0; i < columnNames.size(); ++i) columnIndex[columnNames[i]] = i;
+    }
+
+    // Розбирає CSV-подібний текст: перший рядок — заголовок з назвами колонок, поля
+    // розділені комами (без лапок і екранування). Рядки з неправильною кількістю полів
+    // не відкидаються, а позначаються як некоректні й потрапляють у звіт insertBatch.
+    static RowBatch fromCsv(std::string text) {
+        std::vector<std::pair<size_t, size_t>> lines;
+        for (size_t pos = 0; pos < text.size();) {
+            size_t end = text.find('\n', pos);
+            if (end == std::string::npos) end = text.size();
+            size_t len = end - pos;
+            if (len > 0 && text[pos + len - 1] == '\r') --len;
+            if (len > 0) lines.emplace_back(pos, len);
+            pos = end + 1;
+        }
+        if (lines.empty()) return RowBatch({});
+
+        auto split = [&](std::pair<size_t, size_t> line, std::vector<Cell>& out) {
+            out.clear();
+            size_t start = line.first;
+            const size_t end = line.first + line.second;
+            for (size_t i = start; i <= end; ++i) {
+                if (i == end || text[i] == ',') {
+                    out.push_back({start, i - start});
+                    start = i + 1;
+                }
+            }
+        };
+
+        std::vector<Cell> fields;
+        split(lines[0], fields);
+        std::vector<std::string> names;
+        for (const auto& f : fields) names.push_back(text.substr(f.offset, f.length));
+
+        RowBatch batch(std::move(names));
+        const size_t width = batch.columnNames.size();
+        for (auto& column : batch.cells) column.reserve(lines.size() - 1);
+        for (size_t l = 1; l < lines.size(); ++l) {
+            split(lines[l], fields);
+            if (fields.size() != width) {
+                batch.malformedRows.emplace_back(batch.rows, "Malformed row: expected " + std::to_string(width) +
+                                                             " fields, got " + std::to_string(fields.size()));
+                fields.resize(width, Cell{0, 0});
+            }
+            for (size_t c = 0; c < width; ++c) batch.cells[c].push_back(fields[c]);
+            ++batch.rows;
+        }
+        batch.buffer = std::move(text);
+        return batch;
+    }
+
+    void reserve(size_t n) {
+        for (auto& column : cells) column.reserve(n);
+    }
+
+    // values[i] відповідає columnNames[i].
+    void addRow(const std::vector<std::string_view>& values) {
+        if (values.size() != columnNames.size()) {
+            malformedRows.emplace_back(rows, "Malformed row: expected " + std::to_string(columnNames.size()) +
+                                             " fields, got " + std::to_string(values.size()));
+        }
+        for (size_t c = 0; c < columnNames.size(); ++c) {
+            std::string_view v = c < values.size() ? values[c] : std::string_view();
+            cells[c].push_back({buffer.size(), v.size()});
+            buffer.append(v);
+        }
+        ++rows;
+    }
+
+    size_t rowCount() const { return rows; }
+    const std::vector<std::string>& getColumnNames() const { return columnNames; }
+    const std::vector<std::pair<size_t, std::string>>& getMalformedRows() const { return malformedRows; }
+
+    std::optional<size_t> findColumn(const std::string& column) const {
+        auto it = columnIndex.find(column);
+        if (it == columnIndex.end()) return std::nullopt;
+        return it->second;
+    }
+
+    std::string_view cell(size_t column, size_t row) const {
+        const Cell& c = cells[column][row];
+        return std::string_view(buffer).substr(c.offset, c.length);
+    }
+};
+
+struct RowError {
+    static constexpr size_t kAllRows = SIZE_MAX; // помилка стосується кожного рядка пакета
+
+    size_t row;          // номер рядка в пакеті (з нуля) або kAllRows
+    std::string column;  // порожньо, якщо помилка стосується рядка загалом
+    std::string message;
+};
+
+struct BatchInsertReport {
+    size_t inserted = 0;
+    std::vector<RowError> errors; // упорядковано за номером рядка, помилки kAllRows — першими
+
+    bool ok() const { return errors.empty(); }
+};
+
+// ============================================================================
+// WRITE-AHEAD LOG (GROUP COMMIT)
+// ============================================================================
+
+struct WalOptions {
+    // Скільки флашер чекає на інші вставки після першої, перш ніж робити fsync.
+    // Більший інтервал — більше вставок на один fsync, але довша затримка кожної.
+    std::chrono::microseconds commitInterval{1000};
+    // Буфер такого розміру скидається на диск, не чекаючи кінця інтервалу.
+    size_t maxPendingBytes = 4 << 20;
+};
+
+// Журнал вставок лише на дозапис. Вставка кладе запис у спільний буфер і чекає, поки
+// фоновий потік скине буфер одним write + fdatasync для всієї групи вставок.
+// Запис: u32 довжина тіла, u32 контрольна сума (FNV-1a), u64 LSN, тіло:
+//   назва таблиці, u32 кількість колонок, назви колонок, u32 кількість рядків,
+//   значення клітинок (u32 довжина + байти, колонка за колонкою).
+class WriteAheadLog {
+private:
+    int fd = -1;
+    WalOptions options;
+    std::mutex mutex;
+    std::condition_variable hasWork;
+    std::condition_variable becameDurable;
+    std::string pending;
+    uint64_t lastLsn = 0;      // останній виданий LSN
+    uint64_t pendingLsn = 0;   // найбільший LSN у pending
+    uint64_t durableLsn = 0;   // усі записи з LSN <= durableLsn уже на диску
+    uint64_t syncCount = 0;
+    off_t durableSize = 0;     // довжина файлу з усіма записами до durableLsn
+    bool stopping = false;
+    std::string failure;       // після першої помилки журнал більше не приймає записів
+    std::thread flusher;
+
+    static uint32_t checksum(const char* data, size_t n) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; ++i) h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        return h;
+    }
+
+    template <typename T>
+    static void put(std::string& out, const T& v) { out.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+    static void putString(std::string& out, std::string_view s) {
+        put(out, static_cast<uint32_t>(s.size()));
+        out.append(s.data(), s.size());
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            hasWork.wait(lock, [&] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) return;
+            // Групове підтвердження: даємо іншим вставкам приєднатися до цього fsync.
+            if (!stopping && options.commitInterval.count() > 0) {
+                hasWork.wait_for(lock, options.commitInterval,
+                                 [&] { return stopping || pending.size() >= options.maxPendingBytes; });
+            }
+            std::string batch;
+            batch.swap(pending);
+            const uint64_t batchLsn = pendingLsn;
+            lock.unlock();
+
+            std::string error;
+            for (size_t off = 0; off < batch.size();) {
+                const ssize_t n = ::write(fd, batch.data() + off, batch.size() - off);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    error = std::strerror(errno);
+                    break;
+                }
+                off += static_cast<size_t>(n);
+            }
+            if (error.empty() && ::fdatasync(fd) != 0) error = std::strerror(errno);
+
+            lock.lock();
+            if (error.empty()) {
+                durableLsn = batchLsn;
+                durableSize += static_cast<off_t>(batch.size());
+            } else {
+                // Fail-stop: відрізаємо частково записаний пакет, щоб replay не обривався на
+                // ньому, і відкидаємо все, що чекало в буфері. Нові append() кидають виняток.
+                failure = "WAL write failed: " + error;
+                if (::ftruncate(fd, durableSize) != 0) failure += " (cannot truncate torn tail: " + std::string(std::strerror(errno)) + ")";
+                pending.clear();
+            }
+            ++syncCount;
+            becameDurable.notify_all();
+        }
+    }
+public:
+    // Відкриває (або створює) журнал для дозапису. validLength — довжина коректної
+    // частини файлу після replay: "обірваний" хвіст після збою відрізається.
+    WriteAheadLog(const std::string& path, WalOptions opts, uint64_t lastReplayedLsn = 0, size_t validLength = SIZE_MAX)
+        : options(opts), lastLsn(lastReplayedLsn), pendingLsn(lastReplayedLsn), durableLsn(lastReplayedLsn) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw std::runtime_error("Cannot open WAL '" + path + "': " + std::strerror(errno));
+        if (validLength != SIZE_MAX && ::ftruncate(fd, static_cast<off_t>(validLength)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot truncate WAL '" + path + "': " + std::strerror(errno));
+        }
+        durableSize = ::lseek(fd, 0, SEEK_END);
+        flusher = std::thread([this] { flushLoop(); });
+    }
+
+    ~WriteAheadLog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        hasWork.notify_all();
+        flusher.join();
+        ::close(fd);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Додає прийняті рядки пакета в буфер журналу й повертає їхній LSN. Не чекає диска.
+    // Після помилки запису кидає runtime_error: журнал зупинено до перезапуску.
+    uint64_t append(const std::string& table, const RowBatch& batch, const std::vector<char>& rowOk) {
+        std::string body;
+        putString(body, table);
+        const auto& names = batch.getColumnNames();
+        put(body, static_cast<uint32_t>(names.size()));
+        for (const auto& n : names) putString(body, n);
+        const uint32_t rows = static_cast<uint32_t>(std::count(rowOk.begin(), rowOk.end(), 1));
+        put(body, rows);
+        for (size_t c = 0; c < names.size(); ++c) {
+            for (size_t r = 0; r < batch.rowCount(); ++r) {
+                if (rowOk[r]) putString(body, batch.cell(c, r));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failure.empty()) throw std::runtime_error(failure);
+        const uint64_t lsn = ++lastLsn;
+        put(pending, static_cast<uint32_t>(body.size()));
+        put(pending, checksum(body.data(), body.size()));
+        put(pending, lsn);
+        pending += body;
+        pendingLsn = lsn;
+        hasWork.notify_one();
+        return lsn;
+    }
+
+    void waitDurable(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        becameDurable.wait(lock, [&] { return durableLsn >= lsn || !failure.empty(); });
+        if (durableLsn < lsn) throw std::runtime_error(failure);
+    }
+
+    void throwIfFailed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failure.empty()) throw std::runtime_error(failure);
+    }
+
+    uint64_t getLastLsn() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lastLsn;
+    }
+
+    uint64_t getSyncCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return syncCount;
+    }
+
+    struct ReplayResult {
+        uint64_t lastLsn = 0;
+        size_t validLength = 0; // довжина префікса файлу з цілими записами
+    };
+
+    // Читає журнал і викликає apply(table, batch) для кожного цілого запису з LSN > afterLsn.
+    // Читання зупиняється на першому обірваному чи пошкодженому записі (хвіст після збою).
+    static ReplayResult replay(const std::string& path, uint64_t afterLsn,
+                               const std::function<void(const std::string&, const RowBatch&)>& apply) {
+        ReplayResult result;
+        result.lastLsn = afterLsn;
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return result; // журналу ще немає
+        std::string data;
+        char chunk[1 << 16];
+        for (size_t n; (n = std::fread(chunk, 1, sizeof(chunk), file)) > 0;) data.append(chunk, n);
+        std::fclose(file);
+
+        size_t pos = 0;
+        auto take = [&](size_t& at, size_t end, void* out, size_t n) {
+            if (end - at < n) return false;
+            std::memcpy(out, data.data() + at, n);
+            at += n;
+            return true;
+        };
+        while (true) {
+            uint32_t len, sum;
+            uint64_t lsn;
+            size_t at = pos;
+            if (!take(at, data.size(), &len, 4) || !take(at, data.size(), &sum, 4) || !take(at, data.size(), &lsn, 8)) break;
+            if (data.size() - at < len || checksum(data.data() + at, len) != sum) break;
+            const size_t end = at + len;
+            pos = end;
+            result.validLength = pos;
+            if (lsn <= afterLsn) continue;
+            result.lastLsn = lsn;
+
+            auto str = [&]() {
+                uint32_t n = 0;
+                if (!take(at, end, &n, 4) || end - at < n) throw std::runtime_error("Corrupt WAL record " + std::to_string(lsn));
+                std::string_view v(data.data() + at, n);
+                at += n;
+                return v;
+            };
+            const std::string table(str());
+            uint32_t columnCount = 0, rows = 0;
+            take(at, end, &columnCount, 4);
+            std::vector<std::string> names;
+            for (uint32_t c = 0; c < columnCount; ++c) names.emplace_back(str());
+            take(at, end, &rows, 4);
+            std::vector<std::vector<std::string_view>> cells(columnCount);
+            for (auto& column : cells) {
+                column.reserve(rows);
+                for (uint32_t r = 0; r < rows; ++r) column.push_back(str());
+            }
+            RowBatch batch(std::move(names));
+            batch.reserve(rows);
+            std::vector<std::string_view> row(columnCount);
+            for (uint32_t r = 0; r < rows; ++r) {
+                for (uint32_t c = 0; c < columnCount; ++c) row[c] = cells[c][r];
+                batch.addRow(row);
+            }
+            apply(table, batch);
+        }
+        return result;
+    }
+};
+
+class Table {
+private:
+    std::string name;
+    std::vector<Column> columns;
+    // Колонкове сховище: storage[i] відповідає columns[i], усі сховища мають rowCount значень.
+    std::vector<std::unique_ptr<ColumnStorage>> storage;
+    std::unordered_map<std::string, size_t> columnIndex;
+    size_t rowCount = 0;
+    // Читачі (агрегати, пошук) беруть спільне блокування, вставка — ексклюзивне.
+    // Схема (columns, columnIndex, primaryKeyColumn) після створення не змінюється
+    // і читається без блокування.
+    mutable std::shared_mutex mutex;
+    // Хеш-індекс первинного ключа: розібране значення ключа -> номер рядка. Після
+    // завантаження знімка індекс будується ліниво, при першому зверненні.
+    std::optional<size_t> primaryKeyColumn;
+    mutable std::unordered_map<CellValue, size_t> primaryIndex;
+    mutable std::atomic<bool> primaryIndexReady{true};
+    mutable std::mutex primaryIndexBuild;
+
+    // Викликається під блокуванням таблиці (спільним або ексклюзивним).
+    void ensurePrimaryIndex() const {
+        if (primaryIndexReady.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> guard(primaryIndexBuild);
+        if (primaryIndexReady.load(std::memory_order_relaxed)) return;
+        const ColumnStorage& keys = *storage[*primaryKeyColumn];
+        primaryIndex.reserve(rowCount);
+        for (size_t r = 0; r < rowCount; ++r) primaryIndex.emplace(keys.get(r), r);
+        primaryIndexReady.store(true, std::memory_order_release);
+    }
+
+    std::optional<size_t> findColumn(const std::string& column) const {
+        auto it = columnIndex.find(column);
+        if (it == columnIndex.end()) return std::nullopt;
+        return it->second;
+    }
+
+    // Визначені після Database, бо шукають таблицю, на яку посилається ключ, та WAL бази.
+    std::vector<char> probeForeignKey(size_t column, const std::vector<CellValue>& values) const;
+    uint64_t logInsert(const RowBatch& batch, const std::vector<char>& rowOk) const;
+    // Чекає, доки запис lsn стане довговічним. Якщо WAL не зміг його записати, кидає
+    // runtime_error, а рядки цього пакета лишаються видимими лише в пам'яті: журнал
+    // зупиняється (fail-stop), тож будь-яка наступна вставка чи snapshot() теж кидає
+    // виняток, і база до перезапуску працює лише на читання. Після recover() таких
+    // рядків немає.
+    static void awaitDurable(uint64_t lsn);
+    std::string describeForeignKey(size_t column) const {
+        const auto fk = *columns[column].getForeignKey();
+        return "'" + fk.first + "." + fk.second + "'";
+    }
+public:
+    Table(const std::string& n, const std::vector<Column>& c) : Table(n, c, createStorage(c)) {}
+
+    // Відновлення таблиці зі знімка: сховища вже заповнені (і посилаються на mmap).
+    Table(const std::string& n, const std::vector<Column>& c, std::vector<std::unique_ptr<ColumnStorage>> restored,
+          size_t rows)
+        : Table(n, c, std::move(restored)) {
+        rowCount = rows;
+        primaryIndexReady = !primaryKeyColumn || rows == 0;
+    }
+
+private:
+    static std::vector<std::unique_ptr<ColumnStorage>> createStorage(const std::vector<Column>& columns) {
+        std::vector<std::unique_ptr<ColumnStorage>> result;
+        for (const auto& col : columns) result.push_back(col.getType()->createStorage());
+        return result;
+    }
+
+    Table(const std::string& n, const std::vector<Column>& c, std::vector<std::unique_ptr<ColumnStorage>> restored)
+        : name(n), columns(c), storage(std::move(restored)) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            columnIndex[columns[i].getName()] = i;
+            if (columns[i].isPrimaryKey()) {
+                if (primaryKeyColumn) {
+                    throw std::runtime_error("Table '" + name + "': composite PRIMARY KEY is not supported");
+                }
+                primaryKeyColumn = i;
+            }
+        }
+    }
+
+public:
+
+    void insert(const std::unordered_map<std::string, std::string>& values) {
+        INSTR_SPAN("lab4.Table::insert");
+        // Одиночна вставка — це пакет з одного рядка: перевірки ті самі, а перша помилка
+        // перетворюється на виняток, як і раніше.
+        std::vector<std::string> names;
+        std::vector<std::string_view> row;
+        names.reserve(values.size());
+        row.reserve(values.size());
+        for (const auto& [column, value] : values) {
+            names.push_back(column);
+            row.push_back(value);
+        }
+        RowBatch batch(std::move(names));
+        batch.addRow(row);
+
+        auto report = insertBatch(batch);
+        if (!report.errors.empty()) throw std::runtime_error(report.errors.front().message);
+    }
+
+    // Масова вставка. Кожна колонка валідується окремим щільним циклом, сховище
+    // резервується наперед, а некоректні рядки не вставляються й потрапляють у звіт
+    // замість винятку. Рядок вставляється або повністю, або ніяк.
+    BatchInsertReport insertBatch(const RowBatch& batch) {
+        BatchInsertReport report;
+        const size_t n = batch.rowCount();
+        std::vector<char> rowOk(n, 1);
+        auto reject = [&](size_t r, const std::string& column, std::string message) {
+            rowOk[r] = 0;
+            report.errors.push_back({r, column, std::move(message)});
+        };
+        for (const auto& [r, message] : batch.getMalformedRows()) reject(r, "", message);
+
+        // Спершу валідуємо всі значення, і лише потім дописуємо рядки в колонки,
+        // щоб невдала вставка не залишила "обірваний" рядок у сховищі.
+        std::vector<std::vector<CellValue>> parsed(columns.size());
+        for (size_t i = 0; i < columns.size(); ++i) {
+            const auto& col = columns[i];
+            auto& out = parsed[i];
+            out.resize(n);
+            auto source = batch.findColumn(col.getName());
+
+            if (!source) {
+                // Значення не надано: одна помилка на весь пакет, бо бракує значення в кожному рядку
+                if (n > 0 && (col.isPrimaryKey() || !col.isNullable())) {
+                    std::fill(rowOk.begin(), rowOk.end(), 0);
+                    report.errors.push_back({RowError::kAllRows, col.getName(),
+                                             "Invalid INSERT: Missing value for " +
+                                                 std::string(col.isPrimaryKey() ? "PRIMARY KEY" : "NOT NULL") +
+                                                 " column '" + col.getName() + "'"});
+                }
+                // Це nullable колонка, значення для якої не надали. Зберігаємо NULL.
+                continue;
+            }
+
+            for (size_t r = 0; r < n; ++r) {
+                if (!rowOk[r]) continue; // рядок уже відхилено: не розбираємо й не множимо помилки
+                const std::string_view text = batch.cell(*source, r);
+                auto value = col.parse(text);
+                if (!value) {
+                    reject(r, col.getName(), "Invalid value '" + std::string(text) + "' for column '" + col.getName() + "'");
+                    continue;
+                }
+                out[r] = std::move(*value);
+            }
+        }
+
+        // Зовнішні ключі перевіряються через хеш-індекс первинного ключа таблиці, на яку
+        // посилаються, одним пакетним запитом на колонку.
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (!columns[i].getForeignKey()) continue;
+            std::vector<CellValue> probes;
+            std::vector<size_t> probeRows;
+            for (size_t r = 0; r < n; ++r) {
+                if (!rowOk[r] || isNull(parsed[i][r])) continue;
+                probes.push_back(parsed[i][r]);
+                probeRows.push_back(r);
+            }
+            if (probes.empty()) continue;
+            auto found = probeForeignKey(i, probes);
+            auto source = batch.findColumn(columns[i].getName());
+            for (size_t j = 0; j < probes.size(); ++j) {
+                if (found[j]) continue;
+                const size_t r = probeRows[j];
+                reject(r, columns[i].getName(), "Invalid INSERT: FOREIGN KEY violation, value '" + std::string(batch.cell(*source, r)) +
+                                                "' for column '" + columns[i].getName() + "' not found in " + describeForeignKey(i));
+            }
+        }
+
+        // Далі працюємо з індексом і сховищем, тож беремо ексклюзивне блокування. Розбір
+        // значень і перевірка зовнішніх ключів (яка блокує інші таблиці на читання) вже
+        // виконані без нього, тож взаємних блокувань між таблицями не виникає.
+        std::unique_lock lock(mutex);
+
+        if (primaryKeyColumn) {
+            ensurePrimaryIndex();
+            const auto& keys = parsed[*primaryKeyColumn];
+            const std::string& keyName = columns[*primaryKeyColumn].getName();
+            auto source = batch.findColumn(keyName);
+            std::unordered_map<CellValue, size_t> batchKeys;
+            batchKeys.reserve(n);
+            for (size_t r = 0; r < n; ++r) {
+                if (!rowOk[r]) continue;
+                if (isNull(keys[r])) {
+                    reject(r, keyName, "Invalid INSERT: NULL value for PRIMARY KEY column '" + keyName + "'");
+                } else if (primaryIndex.count(keys[r]) || !batchKeys.emplace(keys[r], r).second) {
+                    reject(r, keyName, "Invalid INSERT: Duplicate value '" + std::string(batch.cell(*source, r)) +
+                                       "' for PRIMARY KEY column '" + keyName + "'");
+                }
+            }
+        }
+
+        std::stable_sort(report.errors.begin(), report.errors.end(), [](const RowError& a, const RowError& b) {
+            return a.row + 1 < b.row + 1; // kAllRows + 1 == 0
+        });
+
+        const size_t accepted = static_cast<size_t>(std::count(rowOk.begin(), rowOk.end(), 1));
+        // Запис у WAL робиться під тим самим блокуванням, що й вставка, тож порядок
+        // записів у журналі збігається з порядком застосування до таблиці.
+        const uint64_t lsn = accepted ? logInsert(batch, rowOk) : 0;
+        for (size_t i = 0; i < columns.size(); ++i) {
+            storage[i]->reserve(rowCount + accepted);
+            for (size_t r = 0; r < n; ++r) {
+                if (rowOk[r]) storage[i]->append(parsed[i][r]);
+            }
+        }
+        if (primaryKeyColumn) {
+            if (accepted > 1) primaryIndex.reserve(rowCount + accepted);
+            auto& keys = parsed[*primaryKeyColumn];
+            size_t row = rowCount;
+            for (size_t r = 0; r < n; ++r) {
+                if (rowOk[r]) primaryIndex.emplace(std::move(keys[r]), row++);
+            }
+        }
+        rowCount += accepted;
+        report.inserted = accepted;
+        INSTR_ADD("lab4.Table::insertBatch.rows", accepted);
+        INSTR_ADD("lab4.Table::insertBatch.errors", report.errors.size());
+
+        // Рядки вже видимі читачам, але викликач отримує результат лише після того,
+        // як запис WAL (разом з іншими вставками цієї групи) потрапив на диск. Якщо
+        // запис не вдався, див. awaitDurable: база стає лише для читання.
+        lock.unlock();
+        awaitDurable(lsn);
+        return report;
+    }
+
+    // Точковий пошук за первинним ключем через хеш-індекс, без сканування таблиці.
+    std::optional<Row> findByKey(const std::string& key) const {
+        if (!primaryKeyColumn) {
+            throw std::runtime_error("Table '" + name + "' has no PRIMARY KEY");
+        }
+        auto parsed = columns[*primaryKeyColumn].getType()->parse(key);
+        if (!parsed) return std::nullopt;
+        std::shared_lock lock(mutex);
+        ensurePrimaryIndex();
+        auto it = primaryIndex.find(*parsed);
+        if (it == primaryIndex.end()) return std::nullopt;
+        return materializeRow(it->second);
+    }
+
+    bool containsKey(const CellValue& key) const {
+        std::shared_lock lock(mutex);
+        ensurePrimaryIndex();
+        return primaryIndex.count(key) != 0;
+    }
+
+    // Пакетна перевірка наявності ключів. Запити групуються за кошиками хеш-таблиці,
+    // а однакові ключі (типово для зовнішніх ключів при масовому завантаженні)
+    // перевіряються лише один раз. result[i] != 0, якщо keys[i] є в індексі.
+    std::vector<char> containsKeys(const std::vector<CellValue>& keys) const {
+        std::vector<char> result(keys.size(), 0);
+        std::shared_lock lock(mutex);
+        ensurePrimaryIndex();
+        if (primaryIndex.empty()) return result;
+
+        const auto hasher = primaryIndex.hash_function();
+        const size_t buckets = primaryIndex.bucket_count();
+        std::vector<std::pair<size_t, size_t>> order; // (кошик, індекс ключа)
+        order.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) order.emplace_back(hasher(keys[i]) % buckets, i);
+        std::sort(order.begin(), order.end());
+
+        for (size_t j = 0; j < order.size(); ++j) {
+            const size_t i = order[j].second;
+            if (j > 0 && order[j - 1].first == order[j].first && keys[order[j - 1].second] == keys[i]) {
+                result[i] = result[order[j - 1].second];
+                continue;
+            }
+            result[i] = primaryIndex.count(keys[i]) != 0;
+        }
+        return result;
+    }
+
+    bool isPrimaryKey(const std::string& column) const {
+        return primaryKeyColumn && columns[*primaryKeyColumn].getName() == column;
+    }
+
+    Row getRow(size_t r) const {
+        std::shared_lock lock(mutex);
+        if (r >= rowCount) throw std::out_of_range("Row " + std::to_string(r) + " is out of range for table '" + name + "'");
+        return materializeRow(r);
+    }
+
+private:
+    Row materializeRow(size_t r) const {
+        std::unordered_map<std::string, std::string> rowData;
+        for (size_t i = 0; i < columns.size(); ++i) {
+            rowData[columns[i].getName()] = storage[i]->getString(r);
+        }
+        return Row(std::move(rowData));
+    }
+
+public:
+
+    // Сумісний з попереднім API рядковий вигляд таблиці. Рядки матеріалізуються з колонок
+    // при кожному виклику, тож для агрегатів слід використовувати count/sum/avg.
+    std::vector<Row> getRows() const {
+        std::shared_lock lock(mutex);
+        std::vector<Row> rows;
+        rows.reserve(rowCount);
+        for (size_t r = 0; r < rowCount; ++r) {
+            rows.push_back(materializeRow(r));
+        }
+        return rows;
+    }
+
+    size_t size() const {
+        std::shared_lock lock(mutex);
+        return rowCount;
+    }
+
+    const std::string& getName() const { return name; }
+    std::shared_lock<std::shared_mutex> lockForRead() const { return std::shared_lock<std::shared_mutex>(mutex); }
+
+    // Запис таблиці у знімок; викликач тримає lockForRead().
+    void writeSnapshot(SnapshotWriter& out) const {
+        out.writeString(name);
+        out.writeValue(static_cast<uint32_t>(columns.size()));
+        out.writeValue(static_cast<uint64_t>(rowCount));
+        for (const auto& col : columns) {
+            out.writeString(col.getName());
+            out.writeString(col.getType()->getName());
+            out.writeValue(static_cast<uint8_t>(col.isNullable()));
+            out.writeValue(static_cast<uint8_t>(col.isPrimaryKey()));
+            const auto fk = col.getForeignKey();
+            out.writeValue(static_cast<uint8_t>(fk.has_value()));
+            if (fk) {
+                out.writeString(fk->first);
+                out.writeString(fk->second);
+            }
+        }
+        for (const auto& column : storage) column->writeTo(out);
+    }
+
+    static std::shared_ptr<Table> readSnapshot(SnapshotReader& in) {
+        const std::string tableName = in.readString();
+        const uint32_t columnCount = in.readValue<uint32_t>();
+        const uint64_t rows = in.readValue<uint64_t>();
+        std::vector<Column> schema;
+        for (uint32_t i = 0; i < columnCount; ++i) {
+            const std::string columnName = in.readString();
+            auto type = createBuiltinType(in.readString());
+            const bool nullable = in.readValue<uint8_t>() != 0;
+            const bool pk = in.readValue<uint8_t>() != 0;
+            std::optional<std::pair<std::string, std::string>> fk;
+            if (in.readValue<uint8_t>() != 0) {
+                std::string fkTable = in.readString();
+                fk = std::make_pair(std::move(fkTable), in.readString());
+            }
+            schema.emplace_back(columnName, std::move(type), nullable, pk, std::move(fk));
+            schema.back().specialize();
+        }
+        auto restored = createStorage(schema);
+        for (auto& column : restored) {
+            column->readFrom(in);
+            if (column->size() != rows) throw std::runtime_error("Corrupt snapshot: row count mismatch in '" + tableName + "'");
+        }
+        return std::make_shared<Table>(tableName, schema, std::move(restored), rows);
+    }
+
+    int count(const std::string& column) const {
+        // Рахуємо, лише якщо значення існує і не є NULL
+        auto idx = findColumn(column);
+        if (!idx) return 0;
+        std::shared_lock lock(mutex);
+        const auto& words = storage[*idx]->getValidity().getWords();
+        std::vector<size_t> partial(chunkCount());
+        WorkStealingPool::instance().parallelFor(partial.size(), [&](size_t chunk) {
+            const size_t from = chunk * kChunkRows / 64;
+            const size_t to = std::min(words.size(), from + kChunkRows / 64);
+            size_t c = 0;
+            for (size_t w = from; w < to; ++w) c += __builtin_popcountll(words[w]);
+            partial[chunk] = c;
+        });
+        size_t total = 0;
+        for (size_t c : partial) total += c;
+        return static_cast<int>(total);
+    }
+
+    double sum(const std::string& column) const {
+        INSTR_SPAN("lab4.Table::sum");
+        auto agg = aggregate(column, "SUM");
+        return agg ? static_cast<double>(agg->sum) : 0.0;
+    }
+
+    double avg(const std::string& column) const {
+        // Один прохід: кількість і сума рахуються тим самим ядром
+        auto agg = aggregate(column, "AVG");
+        if (!agg || agg->count == 0) return 0;
+        // Правильна логіка: ділимо суму на кількість не-пустих значень
+        return static_cast<double>(agg->sum) / agg->count;
+    }
+
+    std::optional<double> min(const std::string& column) const {
+        auto agg = aggregate(column, "MIN");
+        if (!agg || agg->count == 0) return std::nullopt;
+        return static_cast<double>(agg->min);
+    }
+
+    std::optional<double> max(const std::string& column) const {
+        auto agg = aggregate(column, "MAX");
+        if (!agg || agg->count == 0) return std::nullopt;
+        return static_cast<double>(agg->max);
+    }
+
+    // Агрегат з умовами (кон'юнкція RangePredicate і EqualsPredicate). Для кожного фрагмента
+    // спершу перевіряється статистика min/max/NULL колонок умови: фрагменти, що не можуть
+    // містити потрібних рядків, пропускаються, а фрагменти, що повністю задовольняють
+    // умову, агрегуються без побудови маски. nullopt — якщо для AVG/MIN/MAX немає рядків.
+    std::optional<double> aggregateWhere(const Aggregate& aggregate, const std::vector<RangePredicate>& where,
+                                         const std::vector<EqualsPredicate>& equals = {}) const {
+        auto valueIdx = findColumn(aggregate.column);
+        if (!valueIdx) {
+            throw std::runtime_error("Unknown column '" + aggregate.column + "' in table '" + name + "'");
+        }
+        const auto* ints = dynamic_cast<const IntegerColumnStorage*>(storage[*valueIdx].get());
+        if (aggregate.kind != AggregateKind::Count && !ints) {
+            throw std::runtime_error("Aggregate requires a numeric column, got '" + aggregate.column + "'");
         }
-    }
-    std::string getName() const override { return "Integer"; }
-};
+        std::shared_lock lock(mutex);
+        std::vector<ResolvedPredicate> ranges;
+        for (const auto& p : where) ranges.push_back(resolveRange(p));
+        for (const auto& p : equals) ranges.push_back(resolveEquals(p));
 
-class StringType : public DataType {
-public:
-    bool validate(const std::string& value) const override { return true; }
-    std::string getName() const override { return "String"; }
-};
+        const ColumnStorage& values = *storage[*valueIdx];
+        std::vector<IntAggregate> partial(chunkCount());
+        WorkStealingPool::instance().parallelFor(partial.size(), [&](size_t chunk) {
+            const size_t from = chunk * kChunkRows;
+            const size_t rows = std::min(rowCount - from, kChunkRows);
+            const uint64_t* validity = values.getValidity().getWords().data() + from / 64;
 
-class BooleanType : public DataType {
-public:
-    bool validate(const std::string& value) const override {
-        return value == "true" || value == "false" || value == "1" || value == "0";
+            bool fullyMatched = true;
+            for (const auto& range : ranges) {
+                ZoneVerdict verdict = range.inspect(chunk);
+                if (verdict == ZoneVerdict::None) return;
+                fullyMatched = fullyMatched && verdict == ZoneVerdict::All;
+            }
+
+            std::vector<uint64_t> mask;
+            if (!fullyMatched) {
+                mask.assign(validity, validity + (rows + 63) / 64);
+                for (const auto& range : ranges) range.refine(from, rows, mask.data());
+                validity = mask.data();
+            }
+            if (ints) {
+                partial[chunk] = kernels::aggregate(ints->getValues().data() + from, validity, rows);
+            } else {
+                for (size_t w = 0; w < (rows + 63) / 64; ++w) partial[chunk].count += __builtin_popcountll(validity[w]);
+            }
+        });
+
+        IntAggregate result;
+        for (const auto& p : partial) result.merge(p);
+        return finalizeOrNull(aggregate.kind, result);
     }
-    std::string getName() const override { return "Boolean"; }
-};
 
-class DateType : public DataType {
-public:
-    bool validate(const std::string& value) const override {
-        // Покращена базова перевірка формату YYYY-MM-DD.
-        // Справжня реалізація мала б розбирати дату та перевіряти її коректність (напр., місяць <= 12).
-        if (value.size() != 10) return false;
-        if (value[4] != '-' || value[7] != '-') return false;
-        
-        for(int i : {0,1,2,3, 5,6, 8,9}) {
-            if (!isdigit(value[i])) return false;
-        }
-        return true;
+    // COUNT(*) WHERE column == value.
+    int countEqual(const std::string& column, const std::string& value) const {
+        return static_cast<int>(*aggregateWhere({AggregateKind::Count, column}, {}, {{column, value}}));
     }
-    std::string getName() const override { return "Date"; }
-};
 
-// ============================================================================
-// DATABASE CORE CLASSES
-// ============================================================================
+    // GROUP BY column з одним агрегатом. Кожен фрагмент таблиці будує власну хеш-таблицю
+    // груп, часткові результати об'єднуються у порядку фрагментів. Групи впорядковані
+    // за значенням ключа (числа — як числа, дати — хронологічно).
+    std::vector<GroupResult> groupBy(const std::string& column, const Aggregate& aggregate) const {
+        auto keyIdx = findColumn(column);
+        auto valueIdx = findColumn(aggregate.column);
+        if (!keyIdx || !valueIdx) {
+            throw std::runtime_error("Unknown column in GROUP BY on table '" + name + "'");
+        }
+        const auto* ints = dynamic_cast<const IntegerColumnStorage*>(storage[*valueIdx].get());
+        if (aggregate.kind != AggregateKind::Count && !ints) {
+            throw std::runtime_error("GROUP BY aggregate requires a numeric column, got '" + aggregate.column + "'");
+        }
 
-class Column {
-private:
-    std::string name;
-    std::shared_ptr<DataType> type;
-    bool nullable;
-    bool primaryKey;
-    std::optional<std::pair<std::string, std::string>> foreignKey;
-public:
-    Column(const std::string& n, std::shared_ptr<DataType> t, bool nullb = true, bool pk = false,
-           std::optional<std::pair<std::string, std::string>> fk = std::nullopt)
-        : name(n), type(std::move(t)), nullable(nullb), primaryKey(pk), foreignKey(std::move(fk)) {}
+        std::shared_lock lock(mutex);
+        const ColumnStorage& keys = *storage[*keyIdx];
+        const ColumnStorage& values = *storage[*valueIdx];
+        const auto* dictionary = dynamic_cast<const StringColumnStorage*>(&keys);
+        std::vector<std::pair<CellValue, IntAggregate>> ordered;
+        if (dictionary && dictionary->isDictionaryEncoded()) {
+            ordered = groupByCode(*dictionary, values, ints);
+        } else {
+            ordered = groupByValue(keys, values, ints);
+        }
+        std::sort(ordered.begin(), ordered.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
 
-    bool validate(const std::string& value) const {
-        if (value.empty()) {
-            // Порожнє значення припустиме, лише якщо колонка nullable
-            return nullable;
+        std::vector<GroupResult> result;
+        result.reserve(ordered.size());
+        for (const auto& [key, agg] : ordered) {
+            result.push_back({renderValue(key), finalizeOrNull(aggregate.kind, agg)});
         }
-        return type->validate(value);
+        return result;
     }
 
-    std::string getName() const { return name; }
-    std::shared_ptr<DataType> getType() const { return type; }
-    bool isPrimaryKey() const { return primaryKey; }
-    bool isNullable() const { return nullable; }
-    std::optional<std::pair<std::string, std::string>> getForeignKey() const { return foreignKey; }
-};
-
-class Row {
-private:
-    std::unordered_map<std::string, std::string> data;
-public:
-    Row() = default;
-    explicit Row(std::unordered_map<std::string, std::string> d) : data(std::move(d)) {}
-    const std::unordered_map<std::string, std::string>& getData() const { return data; }
-};
-
-class Table {
 private:
-    std::string name;
-    std::vector<Column> columns;
-    std::vector<Row> rows;
-public:
-    Table(const std::string& n, const std::vector<Column>& c) : name(n), columns(c) {}
+    size_t chunkCount() const { return (rowCount + kChunkRows - 1) / kChunkRows; }
 
-    void insert(const std::unordered_map<std::string, std::string>& values) {
-        std::unordered_map<std::string, std::string> rowData;
+    template <typename Key, typename KeyOf>
+    std::vector<std::unordered_map<Key, IntAggregate>> groupChunks(const ColumnStorage& values,
+                                                                  const IntegerColumnStorage* ints,
+                                                                  KeyOf keyOf) const {
+        std::vector<std::unordered_map<Key, IntAggregate>> partial(chunkCount());
+        WorkStealingPool::instance().parallelFor(partial.size(), [&](size_t chunk) {
+            const size_t from = chunk * kChunkRows;
+            const size_t to = std::min(rowCount, from + kChunkRows);
+            auto& groups = partial[chunk];
+            for (size_t r = from; r < to; ++r) {
+                IntAggregate& g = groups[keyOf(r)];
+                if (values.isNull(r)) continue;
+                IntAggregate one;
+                one.count = 1;
+                if (ints) one.sum = one.min = one.max = ints->getValues()[r];
+                g.merge(one);
+            }
+        });
+        return partial;
+    }
 
-        for (const auto& col : columns) {
-            auto it = values.find(col.getName());
-            
-            if (it == values.end()) {
-                // Значення не надано
-                if (col.isPrimaryKey()) {
-                    throw std::runtime_error("Invalid INSERT: Missing value for PRIMARY KEY column '" + col.getName() + "'");
-                }
-                if (!col.isNullable()) {
-                    throw std::runtime_error("Invalid INSERT: Missing value for NOT NULL column '" + col.getName() + "'");
-                }
-                // Це nullable колонка, значення для якої не надали. Зберігаємо порожній рядок.
-                rowData[col.getName()] = "";
-            } else {
-                // Значення надано
-                const std::string& value = it->second;
-                if (!col.validate(value)) {
-                    throw std::runtime_error("Invalid value '" + value + "' for column '" + col.getName() + "'");
-                }
-                
-                // ПРИМІТКА: Тут мала б бути логіка перевірки зовнішнього ключа (Foreign Key)
-                // if (col.getForeignKey().has_value()) { ... }
+    std::vector<std::pair<CellValue, IntAggregate>> groupByValue(const ColumnStorage& keys, const ColumnStorage& values,
+                                                                 const IntegerColumnStorage* ints) const {
+        auto partial = groupChunks<CellValue>(values, ints, [&](size_t r) { return keys.get(r); });
+        std::unordered_map<CellValue, IntAggregate> merged;
+        for (const auto& groups : partial) {
+            for (const auto& [key, agg] : groups) merged[key].merge(agg);
+        }
+        return {merged.begin(), merged.end()};
+    }
 
-                rowData[col.getName()] = value;
-            }
+    // Групування за словниковим кодом: хешується u32 замість рядка, а значення
+    // відновлюються лише для готових груп.
+    std::vector<std::pair<CellValue, IntAggregate>> groupByCode(const StringColumnStorage& keys, const ColumnStorage& values,
+                                                                const IntegerColumnStorage* ints) const {
+        constexpr uint32_t kNullCode = UINT32_MAX;
+        const uint32_t* codes = keys.getCodes().data();
+        auto partial = groupChunks<uint32_t>(values, ints,
+                                             [&](size_t r) { return keys.isNull(r) ? kNullCode : codes[r]; });
+        std::unordered_map<uint32_t, IntAggregate> merged;
+        for (const auto& groups : partial) {
+            for (const auto& [code, agg] : groups) merged[code].merge(agg);
+        }
+        std::vector<std::pair<CellValue, IntAggregate>> result;
+        result.reserve(merged.size());
+        for (const auto& [code, agg] : merged) {
+            CellValue key = std::monostate{};
+            if (code != kNullCode) key = keys.getDictionaryValue(code);
+            result.emplace_back(std::move(key), agg);
         }
-        rows.emplace_back(rowData);
+        return result;
     }
 
-    const std::vector<Row>& getRows() const { return rows; }
+    enum class ZoneVerdict { None, Some, All };
 
-    int count(const std::string& column) const {
-        int c = 0;
-        for (const auto& row : rows) {
-            // Рахуємо, лише якщо значення існує і не є порожнім
-            auto it = row.getData().find(column);
-            if (it != row.getData().end() && !it->second.empty()) {
-                c++;
+    // Умова з уже розібраними межами, прив'язана до типізованого сховища колонки.
+    // Для String-колонки це рівність: code — код значення у словнику (якщо значення
+    // в словнику відсутнє, жоден рядок умову не задовольняє), text — для звичайного кодування.
+    struct ResolvedPredicate {
+        const IntegerColumnStorage* ints = nullptr;
+        const DateColumnStorage* dates = nullptr;
+        const StringColumnStorage* strings = nullptr;
+        int64_t low = INT64_MIN;
+        int64_t high = INT64_MAX;
+        std::optional<uint32_t> code;
+        std::string text;
+
+        template <typename T>
+        ZoneVerdict inspect(const FixedWidthColumnStorage<T>& column, size_t chunk) const {
+            const ZoneStats<T>& zone = column.getZones()[chunk];
+            if (zone.allNull() || zone.max < low || zone.min > high) return ZoneVerdict::None;
+            if (zone.nullCount == 0 && zone.min >= low && zone.max <= high) return ZoneVerdict::All;
+            return ZoneVerdict::Some;
+        }
+
+        ZoneVerdict inspect(size_t chunk) const {
+            if (strings) return strings->isDictionaryEncoded() && !code ? ZoneVerdict::None : ZoneVerdict::Some;
+            return ints ? inspect(*ints, chunk) : inspect(*dates, chunk);
+        }
+
+        // mask &= (low <= value <= high && value не NULL) для рядків [from, from + rows).
+        template <typename T>
+        void refine(const FixedWidthColumnStorage<T>& column, size_t from, size_t rows, uint64_t* mask) const {
+            const T* v = column.getValues().data() + from;
+            const uint64_t* valid = column.getValidity().getWords().data() + from / 64;
+            for (size_t w = 0; w * 64 < rows; ++w) {
+                const size_t n = std::min<size_t>(64, rows - w * 64);
+                uint64_t bits = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    const int64_t x = v[w * 64 + i];
+                    bits |= uint64_t(x >= low && x <= high) << i;
+                }
+                mask[w] &= bits & valid[w];
             }
         }
-        return c;
-    }
 
-    double sum(const std::string& column) const {
-        double s = 0;
-        
-        // Перевіряємо, чи колонка взагалі числова
-        bool isNumeric = false;
-        for(const auto& col : columns) {
-            if(col.getName() == column) {
-                if (dynamic_cast<IntegerType*>(col.getType().get())) {
-                    isNumeric = true;
+        // mask &= (value == text) для рядків [from, from + rows).
+        void refineString(size_t from, size_t rows, uint64_t* mask) const {
+            const uint64_t* valid = strings->getValidity().getWords().data() + from / 64;
+            const uint32_t* c = strings->isDictionaryEncoded() ? strings->getCodes().data() + from : nullptr;
+            for (size_t w = 0; w * 64 < rows; ++w) {
+                const size_t n = std::min<size_t>(64, rows - w * 64);
+                uint64_t bits = 0;
+                if (c) {
+                    for (size_t i = 0; i < n; ++i) bits |= uint64_t(c[w * 64 + i] == *code) << i;
+                } else {
+                    for (size_t i = 0; i < n; ++i) bits |= uint64_t(strings->equals(from + w * 64 + i, text)) << i;
                 }
-                // Тут можна додати перевірки на FloatType, DecimalType тощо.
-                break;
+                mask[w] &= bits & valid[w];
             }
         }
 
-        if (!isNumeric) {
-             std::cerr << "Warning: Attempted to SUM non-numeric column '" << column << "'" << std::endl;
-             return 0.0;
+        void refine(size_t from, size_t rows, uint64_t* mask) const {
+            if (strings) refineString(from, rows, mask);
+            else if (ints) refine(*ints, from, rows, mask);
+            else refine(*dates, from, rows, mask);
         }
+    };
 
-        for (const auto& row : rows) {
-            auto it = row.getData().find(column);
-            if (it != row.getData().end() && !it->second.empty()) {
-                try {
-                    s += std::stod(it->second);
-                } catch (const std::exception&) {
-                    // Ігноруємо невалідні дані (напр., порожній рядок) під час підрахунку суми
-                }
+    // Викликач тримає блокування читання: словник колонки змінюється при вставці.
+    ResolvedPredicate resolveEquals(const EqualsPredicate& predicate) const {
+        auto idx = findColumn(predicate.column);
+        if (!idx) {
+            throw std::runtime_error("Unknown column '" + predicate.column + "' in table '" + name + "'");
+        }
+        if (auto strings = dynamic_cast<const StringColumnStorage*>(storage[*idx].get())) {
+            ResolvedPredicate equals;
+            equals.strings = strings;
+            equals.text = predicate.value;
+            if (strings->isDictionaryEncoded()) equals.code = strings->findCode(predicate.value);
+            return equals;
+        }
+        return resolveRange({predicate.column, predicate.value, predicate.value});
+    }
+
+    ResolvedPredicate resolveRange(const RangePredicate& predicate) const {
+        auto idx = findColumn(predicate.column);
+        if (!idx) {
+            throw std::runtime_error("Unknown column '" + predicate.column + "' in table '" + name + "'");
+        }
+        ResolvedPredicate range;
+        range.ints = dynamic_cast<const IntegerColumnStorage*>(storage[*idx].get());
+        range.dates = dynamic_cast<const DateColumnStorage*>(storage[*idx].get());
+        if (!range.ints && !range.dates) {
+            throw std::runtime_error("Range predicate requires an Integer or Date column, got '" + predicate.column + "'");
+        }
+        auto bound = [&](const std::string& text, int64_t unbounded) -> int64_t {
+            if (text.empty()) return unbounded;
+            auto v = columns[*idx].getType()->parse(text);
+            if (!v) {
+                throw std::runtime_error("Invalid bound '" + text + "' for column '" + predicate.column + "'");
             }
+            if (auto i = std::get_if<int64_t>(&*v)) return *i;
+            return std::get<int32_t>(*v);
+        };
+        range.low = bound(predicate.low, INT64_MIN);
+        range.high = bound(predicate.high, INT64_MAX);
+        return range;
+    }
+
+    static std::string renderValue(const CellValue& value) {
+        if (isNull(value)) return "NULL";
+        if (auto v = std::get_if<int64_t>(&value)) return std::to_string(*v);
+        if (auto v = std::get_if<bool>(&value)) return *v ? "true" : "false";
+        if (auto v = std::get_if<int32_t>(&value)) return formatDate(*v);
+        return std::get<std::string>(value);
+    }
+
+    static double finalize(AggregateKind kind, const IntAggregate& agg) {
+        switch (kind) {
+            case AggregateKind::Count: return static_cast<double>(agg.count);
+            case AggregateKind::Sum: return static_cast<double>(agg.sum);
+            case AggregateKind::Avg: return agg.count ? static_cast<double>(agg.sum) / agg.count : 0.0;
+            case AggregateKind::Min: return static_cast<double>(agg.min);
+            case AggregateKind::Max: return static_cast<double>(agg.max);
         }
-        return s;
+        return 0.0;
     }
 
-    double avg(const std::string& column) const {
-        int num = count(column); // Рахуємо тільки ті рядки, де є значення
-        if (num == 0) return 0;
-        // Правильна логіка: ділимо суму на кількість не-пустих значень
-        return sum(column) / num;
+    // AVG/MIN/MAX без жодного не-NULL значення - це NULL, а не сентинели IntAggregate.
+    static std::optional<double> finalizeOrNull(AggregateKind kind, const IntAggregate& agg) {
+        if (agg.count == 0 && kind != AggregateKind::Count && kind != AggregateKind::Sum) return std::nullopt;
+        return finalize(kind, agg);
+    }
+
+    std::optional<IntAggregate> aggregate(const std::string& column, const char* op) const {
+        // Перевіряємо, чи колонка взагалі числова
+        auto idx = findColumn(column);
+        const auto* ints = idx ? dynamic_cast<const IntegerColumnStorage*>(storage[*idx].get()) : nullptr;
+        // Тут можна додати перевірки на FloatType, DecimalType тощо.
+
+        if (!ints) {
+             std::cerr << "Warning: Attempted to " << op << " non-numeric column '" << column << "'" << std::endl;
+             return std::nullopt;
+        }
+
+        // Таблиця ділиться на фрагменти по kChunkRows рядків; кожен фрагмент дає частковий
+        // результат, а об'єднання йде в порядку фрагментів.
+        std::shared_lock lock(mutex);
+        const int64_t* values = ints->getValues().data();
+        const uint64_t* validity = ints->getValidity().getWords().data();
+        std::vector<IntAggregate> partial(chunkCount());
+        WorkStealingPool::instance().parallelFor(partial.size(), [&](size_t chunk) {
+            const size_t from = chunk * kChunkRows;
+            const size_t rows = std::min(rowCount - from, kChunkRows);
+            partial[chunk] = kernels::aggregate(values + from, validity + from / 64, rows);
+        });
+        IntAggregate result;
+        for (const auto& p : partial) result.merge(p);
+        return result;
     }
 };
 
@@ -207,6 +2228,10 @@ public:
 class Database {
 private:
     std::unordered_map<std::string, std::shared_ptr<Table>> tables;
+    // Захищає лише мапу таблиць; кожна таблиця має власне блокування.
+    mutable std::shared_mutex mutex;
+    std::unique_ptr<WriteAheadLog> wal;
+    uint64_t snapshotLsn = 0; // LSN журналу, який уже враховано в завантаженому знімку
     Database() = default;
 public:
     static Database& getInstance() {
@@ -218,23 +2243,146 @@ public:
     Database& operator=(const Database&) = delete;
 
     std::shared_ptr<Table> createTable(const std::string& name, const std::vector<Column>& columns) {
+        auto table = std::make_shared<Table>(name, columns);
+        std::unique_lock lock(mutex);
         if (tables.count(name)) {
             throw std::runtime_error("Table with name '" + name + "' already exists.");
         }
-        auto table = std::make_shared<Table>(name, columns);
         tables[name] = table;
         return table;
     }
 
     std::shared_ptr<Table> getTable(const std::string& name) {
+        std::shared_lock lock(mutex);
         try {
             return tables.at(name);
         } catch (const std::out_of_range&) {
             throw std::runtime_error("Table with name '" + name + "' not found.");
         }
     }
+
+    std::vector<std::string> getTableNames() const {
+        std::shared_lock lock(mutex);
+        std::vector<std::string> names;
+        for (const auto& entry : tables) names.push_back(entry.first);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    // Записує узгоджений знімок усіх таблиць. Усі таблиці блокуються на читання одночасно,
+    // тож читачі працюють далі, а вставки чекають до кінця запису. Файл спершу пишеться
+    // поруч (path + ".tmp") і атомарно замінює попередній знімок після fsync.
+    void snapshot(const std::string& path) const {
+        std::vector<std::shared_ptr<Table>> snapshotTables;
+        for (const auto& tableName : getTableNames()) {
+            std::shared_lock lock(mutex);
+            auto it = tables.find(tableName);
+            if (it != tables.end()) snapshotTables.push_back(it->second);
+        }
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        for (const auto& table : snapshotTables) locks.push_back(table->lockForRead());
+        // Після збою WAL у пам'яті можуть бути рядки, про невдачу яких уже повідомлено;
+        // знімок не повинен робити їх довговічними.
+        if (wal) wal->throwIfFailed();
+        // Поки всі таблиці заблоковані, жоден запис WAL не може бути виданий без
+        // застосування, тож усі записи до lastLsn уже є в знімку.
+        const uint64_t coveredLsn = wal ? wal->getLastLsn() : snapshotLsn;
+
+        const std::string tmpPath = path + ".tmp";
+        std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (!file) throw std::runtime_error("Cannot create snapshot '" + tmpPath + "': " + std::strerror(errno));
+        try {
+            SnapshotWriter out(file);
+            out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+            out.writeValue(kSnapshotVersion);
+            out.writeValue(static_cast<uint32_t>(snapshotTables.size()));
+            out.writeValue(coveredLsn);
+            for (const auto& table : snapshotTables) table->writeSnapshot(out);
+            if (std::fflush(file) != 0 || ::fsync(fileno(file)) != 0) throw std::runtime_error("Snapshot flush failed");
+        } catch (...) {
+            std::fclose(file);
+            std::remove(tmpPath.c_str());
+            throw;
+        }
+        std::fclose(file);
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Cannot replace snapshot '" + path + "': " + std::strerror(errno));
+        }
+    }
+
+    // Відкриває знімок через mmap і реєструє його таблиці. Дані колонок не копіюються
+    // і не розбираються — сховища посилаються на відображені сторінки, доки таблицю
+    // не змінять. Індекси первинних ключів будуються ліниво.
+    void loadSnapshot(const std::string& path) {
+        auto file = std::make_shared<MappedFile>(path);
+        SnapshotReader in(file->data(), file->size(), file);
+        char magic[sizeof(kSnapshotMagic)];
+        for (char& c : magic) c = in.readValue<char>();
+        if (!std::equal(std::begin(magic), std::end(magic), std::begin(kSnapshotMagic))) {
+            throw std::runtime_error("'" + path + "' is not a lab4 snapshot");
+        }
+        if (in.readValue<uint32_t>() != kSnapshotVersion) {
+            throw std::runtime_error("Unsupported snapshot version in '" + path + "'");
+        }
+        const uint32_t tableCount = in.readValue<uint32_t>();
+        const uint64_t coveredLsn = in.readValue<uint64_t>();
+        std::vector<std::shared_ptr<Table>> loaded;
+        for (uint32_t i = 0; i < tableCount; ++i) loaded.push_back(Table::readSnapshot(in));
+
+        std::unique_lock lock(mutex);
+        for (const auto& table : loaded) {
+            if (tables.count(table->getName())) {
+                throw std::runtime_error("Table with name '" + table->getName() + "' already exists.");
+            }
+        }
+        for (auto& table : loaded) tables[table->getName()] = std::move(table);
+        snapshotLsn = std::max(snapshotLsn, coveredLsn);
+    }
+
+    // Відновлення після збою: знімок (якщо він є) + повтор записів WAL, новіших за нього,
+    // після чого журнал відкривається для нових вставок. Схема таблиць, створених
+    // після знімка, має бути відтворена через TableBuilder до виклику recover.
+    void recover(const std::string& snapshotPath, const std::string& walPath, WalOptions options = {}) {
+        if (wal) throw std::runtime_error("WAL is already enabled");
+        if (::access(snapshotPath.c_str(), F_OK) == 0) loadSnapshot(snapshotPath);
+        auto replayed = WriteAheadLog::replay(walPath, snapshotLsn, [&](const std::string& table, const RowBatch& batch) {
+            auto report = getTable(table)->insertBatch(batch);
+            if (!report.ok()) {
+                throw std::runtime_error("WAL replay failed for table '" + table + "': " + report.errors.front().message);
+            }
+        });
+        wal = std::make_unique<WriteAheadLog>(walPath, options, replayed.lastLsn, replayed.validLength);
+    }
+
+    // Вмикає журнал для порожньої бази (без повтору). Увімкнення — до початку вставок.
+    void enableWal(const std::string& walPath, WalOptions options = {}) { recover("", walPath, options); }
+
+    // Закриває журнал (дочекавшись скидання буфера). Лише коли вставок немає.
+    void disableWal() { wal.reset(); }
+
+    WriteAheadLog* getWal() const { return wal.get(); }
 };
 
+inline std::vector<char> Table::probeForeignKey(size_t column, const std::vector<CellValue>& values) const {
+    const auto fk = *columns[column].getForeignKey();
+    auto target = Database::getInstance().getTable(fk.first);
+    if (!target->isPrimaryKey(fk.second)) {
+        throw std::runtime_error("FOREIGN KEY on column '" + columns[column].getName() + "' must reference the PRIMARY KEY of '" +
+                                 fk.first + "', not column '" + fk.second + "'");
+    }
+    return target->containsKeys(values);
+}
+
+inline uint64_t Table::logInsert(const RowBatch& batch, const std::vector<char>& rowOk) const {
+    WriteAheadLog* wal = Database::getInstance().getWal();
+    return wal ? wal->append(name, batch, rowOk) : 0;
+}
+
+inline void Table::awaitDurable(uint64_t lsn) {
+    if (lsn == 0) return;
+    if (WriteAheadLog* wal = Database::getInstance().getWal()) wal->waitDurable(lsn);
+}
+
 class TableBuilder {
 private:
     std::string name;
@@ -250,17 +2398,401 @@ public:
     }
 
     std::shared_ptr<Table> build() {
+        for (auto& column : columns) column.specialize();
         return Database::getInstance().createTable(name, columns);
     }
 };
 
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+// Масштабування читачів: N потоків виконують точкові пошуки та агрегати, поки окремий
+// потік безперервно вставляє рядки. Запуск: ./main bench-readers
+void runReaderScalingBenchmark() {
+    using Clock = std::chrono::steady_clock;
+    const int preloadRows = 200000;
+    const auto duration = std::chrono::milliseconds(500);
+
+    auto table = TableBuilder("bench_readers")
+        .addColumn("id", std::make_shared<IntegerType>(), false, true)
+        .addColumn("value", std::make_shared<IntegerType>(), true)
+        .build();
+
+    std::atomic<int64_t> nextId{0};
+    auto insertChunk = [&](int rows) {
+        RowBatch batch({"id", "value"});
+        batch.reserve(rows);
+        for (int i = 0; i < rows; ++i) {
+            const std::string id = std::to_string(nextId++);
+            batch.addRow({id, id});
+        }
+        table->insertBatch(batch);
+    };
+    insertChunk(preloadRows);
+
+    const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    std::cout << "readers,lookups_per_sec,sums_per_sec,writer_rows_per_sec" << std::endl;
+    for (unsigned readers : threadCounts) {
+        std::atomic<bool> stop{false};
+        std::atomic<int64_t> lookups{0}, sums{0}, written{0};
+
+        std::thread writer([&] {
+            while (!stop) {
+                insertChunk(1000);
+                written += 1000;
+            }
+        });
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < readers; ++t) {
+            pool.emplace_back([&, t] {
+                uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+                int64_t localLookups = 0, localSums = 0;
+                while (!stop) {
+                    for (int i = 0; i < 255; ++i) {
+                        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                        table->findByKey(std::to_string(x % preloadRows));
+                    }
+                    localLookups += 255;
+                    table->sum("value");
+                    ++localSums;
+                }
+                lookups += localLookups;
+                sums += localSums;
+            });
+        }
+
+        const auto start = Clock::now();
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto& th : pool) th.join();
+        writer.join();
+        const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << readers << "," << static_cast<int64_t>(lookups / secs) << ","
+                  << static_cast<int64_t>(sums / secs) << "," << static_cast<int64_t>(written / secs) << std::endl;
+    }
+}
+
+// Групове підтвердження WAL: кілька потоків вставляють по одному рядку, кожна вставка
+// чекає fsync. Для кожного інтервалу коміту — вставок/с, fsync/с і середня затримка.
+// Запуск: ./main bench-wal [шлях до журналу]
+void runWalBenchmark(const std::string& walPath) {
+    using Clock = std::chrono::steady_clock;
+    auto& db = Database::getInstance();
+    const auto duration = std::chrono::milliseconds(1000);
+    const std::vector<int> intervalsUs = {0, 100, 1000, 5000};
+
+    std::cout << "commit_interval_us,writers,inserts_per_sec,fsyncs_per_sec,avg_latency_us" << std::endl;
+    for (unsigned writers : {1u, 16u, 64u})
+    for (int intervalUs : intervalsUs) {
+        std::remove(walPath.c_str());
+        WalOptions options;
+        options.commitInterval = std::chrono::microseconds(intervalUs);
+        db.enableWal(walPath, options);
+        auto table = TableBuilder("bench_wal_" + std::to_string(writers) + "_" + std::to_string(intervalUs))
+            .addColumn("id", std::make_shared<IntegerType>(), false, true)
+            .addColumn("value", std::make_shared<IntegerType>(), true)
+            .build();
+
+        std::atomic<bool> stop{false};
+        std::atomic<int64_t> nextId{0}, inserted{0};
+        std::vector<std::thread> pool;
+        const auto start = Clock::now();
+        for (unsigned t = 0; t < writers; ++t) {
+            pool.emplace_back([&] {
+                while (!stop) {
+                    const std::string id = std::to_string(nextId++);
+                    table->insert({{"id", id}, {"value", id}});
+                    ++inserted;
+                }
+            });
+        }
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto& th : pool) th.join();
+        const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+        const uint64_t syncs = db.getWal()->getSyncCount();
+        db.disableWal();
+
+        std::cout << intervalUs << "," << writers << "," << static_cast<int64_t>(inserted / secs) << ","
+                  << static_cast<int64_t>(syncs / secs) << ","
+                  << static_cast<int64_t>(secs * 1e6 * writers / std::max<int64_t>(1, inserted)) << std::endl;
+    }
+    std::remove(walPath.c_str());
+}
+
+// Набір мікро- і макробенчмарків рушія з машинозчитуваним виводом для відстеження
+// регресій між версіями. Кожен випадок, що залежить від даних, запускається у двох
+// варіантах: без NULL і з 90% NULL у колонці значень.
+// Запуск: ./main bench [--max-rows N] [--format csv|json] [--min-time-ms N]
+struct BenchOptions {
+    size_t maxRows = 1000000;
+    std::string format = "csv";
+    std::chrono::milliseconds minTime{200};
+};
+
+struct BenchResult {
+    std::string name;
+    std::string nulls;  // "none", "heavy" або "-" для випадків, де дані не важливі
+    size_t rows;
+    unsigned threads;
+    uint64_t iterations;
+    double nsPerOp;
+    double itemsPerSec;
+};
+
+class BenchmarkSuite {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    BenchOptions options;
+    std::vector<BenchResult> results;
+
+    static constexpr double kHeavyNullFraction = 0.9;
+
+    // Повторює op, подвоюючи кількість викликів, доки сумарний час не перевищить minTime.
+    template <typename Op>
+    std::pair<uint64_t, double> measure(Op&& op) const {
+        uint64_t total = 0;
+        double secs = 0;
+        for (uint64_t batch = 1; secs * 1000 < options.minTime.count(); batch *= 2) {
+            const auto start = Clock::now();
+            for (uint64_t i = 0; i < batch; ++i) op();
+            secs += std::chrono::duration<double>(Clock::now() - start).count();
+            total += batch;
+        }
+        return {total, secs};
+    }
+
+    void record(std::string name, bool heavy, size_t rows, unsigned threads, uint64_t iterations, double secs,
+                double itemsPerOp) {
+        results.push_back({std::move(name), heavy ? "heavy" : "none", rows, threads, iterations,
+                           secs * 1e9 / iterations, itemsPerOp * iterations / secs});
+    }
+
+    // Таблиці бенчмарку не реєструються в Database: так вони звільняються після випадку.
+    static std::shared_ptr<Table> createTable(const std::string& name) {
+        std::vector<Column> columns;
+        columns.emplace_back("id", std::make_shared<IntegerType>(), false, true);
+        columns.emplace_back("value", std::make_shared<IntegerType>(), true);
+        for (auto& column : columns) column.specialize();
+        return std::make_shared<Table>(name, columns);
+    }
+
+    // Дописує рядки [from, to); значення детерміновані, NULL — з імовірністю kHeavyNullFraction.
+    static void fill(Table& table, size_t from, size_t to, bool heavy) {
+        const size_t chunk = 1 << 20;
+        for (size_t begin = from; begin < to; begin += chunk) {
+            const size_t end = std::min(to, begin + chunk);
+            RowBatch batch({"id", "value"});
+            batch.reserve(end - begin);
+            std::string id, value;
+            for (size_t r = begin; r < end; ++r) {
+                id = std::to_string(r);
+                value.clear();
+                if (!heavy || mix(r) % 1000 >= kHeavyNullFraction * 1000) value = std::to_string(mix(r) % 1000);
+                batch.addRow({id, value});
+            }
+            table.insertBatch(batch);
+        }
+    }
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33; x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ull;
+        return x ^ (x >> 33);
+    }
+
+    std::vector<size_t> rowCounts() const {
+        std::vector<size_t> counts;
+        for (size_t n = 1000; n < options.maxRows; n *= 10) counts.push_back(n);
+        counts.push_back(options.maxRows);
+        return counts;
+    }
+
+    void runInsert(bool heavy) {
+        const size_t rows = std::min<size_t>(options.maxRows, 100000);
+        {
+            auto table = createTable("bench_insert");
+            const auto start = Clock::now();
+            for (size_t r = 0; r < rows; ++r) {
+                std::string value;
+                if (!heavy || mix(r) % 1000 >= kHeavyNullFraction * 1000) value = std::to_string(mix(r) % 1000);
+                table->insert({{"id", std::to_string(r)}, {"value", value}});
+            }
+            record("insert", heavy, rows, 1, rows, std::chrono::duration<double>(Clock::now() - start).count(), 1);
+        }
+        {
+            auto table = createTable("bench_insert_batch");
+            const auto start = Clock::now();
+            fill(*table, 0, rows, heavy);
+            record("insert_batch", heavy, rows, 1, rows, std::chrono::duration<double>(Clock::now() - start).count(), 1);
+        }
+    }
+
+    // Скани та точкові пошуки на таблиці, що зростає від 1K до maxRows рядків.
+    void runScansAndLookups(bool heavy) {
+        auto table = createTable("bench_scan");
+        size_t filled = 0;
+        for (size_t rows : rowCounts()) {
+            fill(*table, filled, rows, heavy);
+            filled = rows;
+
+            auto [n, secs] = measure([&] { table->count("value"); });
+            record("count", heavy, rows, 1, n, secs, static_cast<double>(rows));
+            std::tie(n, secs) = measure([&] { table->sum("value"); });
+            record("sum", heavy, rows, 1, n, secs, static_cast<double>(rows));
+            std::tie(n, secs) = measure([&] { table->avg("value"); });
+            record("avg", heavy, rows, 1, n, secs, static_cast<double>(rows));
+
+            // Ключі готуються заздалегідь, щоб не міряти std::to_string.
+            std::vector<std::string> keys(1024);
+            for (size_t i = 0; i < keys.size(); ++i) keys[i] = std::to_string(mix(i) % rows);
+            size_t next = 0;
+            std::tie(n, secs) = measure([&] { table->findByKey(keys[next++ % keys.size()]); });
+            record("find_by_key", heavy, rows, 1, n, secs, 1);
+        }
+    }
+
+    // Конкуренція за каталог: усі потоки одночасно викликають Database::getTable.
+    void runCatalogContention() {
+        auto& db = Database::getInstance();
+        std::vector<std::string> names;
+        for (int i = 0; i < 16; ++i) {
+            names.push_back("bench_catalog_" + std::to_string(i));
+            try {
+                db.getTable(names.back());
+            } catch (const std::runtime_error&) {
+                TableBuilder(names.back()).addColumn("id", std::make_shared<IntegerType>(), false, true).build();
+            }
+        }
+
+        const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> threadCounts;
+        for (unsigned t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+        threadCounts.push_back(maxThreads);
+
+        for (unsigned threads : threadCounts) {
+            std::atomic<bool> stop{false};
+            std::atomic<uint64_t> calls{0};
+            std::vector<std::thread> pool;
+            const auto start = Clock::now();
+            for (unsigned t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    uint64_t local = 0;
+                    for (size_t i = t; !stop; ++i) {
+                        db.getTable(names[i % names.size()]);
+                        ++local;
+                    }
+                    calls += local;
+                });
+            }
+            std::this_thread::sleep_for(options.minTime);
+            stop = true;
+            for (auto& th : pool) th.join();
+            const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+            results.push_back({"get_table", "-", names.size(), threads, calls.load(),
+                               secs * 1e9 * threads / std::max<uint64_t>(1, calls), calls / secs});
+        }
+    }
+
+    void printCsv() const {
+        std::cout << "case,nulls,rows,threads,iterations,ns_per_op,items_per_sec" << std::endl;
+        for (const auto& r : results) {
+            std::cout << r.name << "," << r.nulls << "," << r.rows << "," << r.threads << "," << r.iterations << ","
+                      << r.nsPerOp << "," << r.itemsPerSec << std::endl;
+        }
+    }
+
+    void printJson() const {
+        std::cout << "{\n  \"context\": {\"max_rows\": " << options.maxRows
+                  << ", \"hardware_threads\": " << std::thread::hardware_concurrency()
+                  << ", \"min_time_ms\": " << options.minTime.count() << "},\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::cout << (i ? "," : "") << "\n    {\"case\": \"" << r.name << "\", \"nulls\": \"" << r.nulls
+                      << "\", \"rows\": " << r.rows << ", \"threads\": " << r.threads
+                      << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.nsPerOp
+                      << ", \"items_per_sec\": " << r.itemsPerSec << "}";
+        }
+        std::cout << "\n  ]\n}" << std::endl;
+    }
+public:
+    explicit BenchmarkSuite(BenchOptions o) : options(std::move(o)) {}
+
+    void run() {
+        for (bool heavy : {false, true}) {
+            runInsert(heavy);
+            runScansAndLookups(heavy);
+        }
+        runCatalogContention();
+        if (options.format == "json") printJson();
+        else printCsv();
+    }
+};
+
+// Розбір аргументів ./main bench; nullopt — якщо аргументи некоректні.
+std::optional<BenchOptions> parseBenchOptions(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) return std::nullopt;
+        const std::string value = argv[++i];
+        auto number = validators::parseInteger(value);
+        if (arg == "--format" && (value == "csv" || value == "json")) {
+            options.format = value;
+        } else if (arg == "--max-rows" && number && std::get<int64_t>(*number) >= 1000) {
+            options.maxRows = static_cast<size_t>(std::get<int64_t>(*number));
+        } else if (arg == "--min-time-ms" && number && std::get<int64_t>(*number) > 0) {
+            options.minTime = std::chrono::milliseconds(std::get<int64_t>(*number));
+        } else {
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
 // ============================================================================
 // DEMONSTRATION
 // ============================================================================
 
-int main() {
+int main(int argc, char** argv) {
     auto& db = Database::getInstance();
 
+    if (argc > 1 && std::string(argv[1]) == "bench-readers") {
+        runReaderScalingBenchmark();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        auto options = parseBenchOptions(argc, argv);
+        if (!options) {
+            std::cerr << "Usage: " << argv[0] << " bench [--max-rows N>=1000] [--format csv|json] [--min-time-ms N]" << std::endl;
+            return 1;
+        }
+        BenchmarkSuite(*options).run();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench-wal") {
+        runWalBenchmark(argc > 2 ? argv[2] : "bench.wal");
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "load") {
+        // Швидкий старт зі знімка: ./main load <path>
+        const auto start = std::chrono::steady_clock::now();
+        db.loadSnapshot(argv[2]);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loaded snapshot in " << ms << " ms" << std::endl;
+        for (const auto& tableName : db.getTableNames()) {
+            std::cout << "  " << tableName << ": " << db.getTable(tableName)->size() << " rows" << std::endl;
+        }
+        return 0;
+    }
+
     auto users = TableBuilder("users")
         .addColumn("id", std::make_shared<IntegerType>(), false, true)
         .addColumn("name", std::make_shared<StringType>(), false) // NOT NULL
@@ -298,12 +2830,81 @@ int main() {
         std::cout << "Caught expected error: " << e.what() << std::endl;
     }
 
+    try {
+        // Тест на унікальність Primary Key
+        std::cout << "\nTesting PRIMARY KEY uniqueness (should fail)..." << std::endl;
+        users->insert({{"id", "2"}, {"name", "Clone"}}); // id = 2 вже існує
+    } catch (const std::exception& e) {
+        std::cout << "Caught expected error: " << e.what() << std::endl;
+    }
+
+    std::cout << "\n--- Lookup by PRIMARY KEY ---" << std::endl;
+    if (auto row = users->findByKey("2")) {
+        std::cout << "id=2 -> name: " << row->getData().at("name") << std::endl;
+    }
+    std::cout << "id=42 found: " << (users->findByKey("42") ? "yes" : "no") << std::endl;
+
+    auto orders = TableBuilder("orders")
+        .addColumn("id", std::make_shared<IntegerType>(), false, true)
+        .addColumn("user_id", std::make_shared<IntegerType>(), false, false, std::make_pair(std::string("users"), std::string("id")))
+        .addColumn("placed", std::make_shared<DateType>(), true)
+        .build();
+
+    try {
+        orders->insert({{"id", "1"}, {"user_id", "1"}, {"placed", "2024-03-01"}});
+        orders->insert({{"id", "2"}, {"user_id", "3"}});
+        std::cout << "\nSuccessfully inserted 2 orders." << std::endl;
+
+        // Тест на порушення Foreign Key
+        std::cout << "Testing FOREIGN KEY constraint (should fail)..." << std::endl;
+        orders->insert({{"id", "3"}, {"user_id", "99"}}); // користувача 99 не існує
+    } catch (const std::exception& e) {
+        std::cout << "Caught expected error: " << e.what() << std::endl;
+    }
+
+    std::cout << "\n--- Bulk INSERT ---" << std::endl;
+    auto report = users->insertBatch(RowBatch::fromCsv(
+        "id,name,age\n"
+        "10,Olena,41\n"
+        "11,Taras,\n"
+        "12,Iryna,abc\n"  // некоректний вік
+        "1,Dup,20\n"      // id = 1 вже існує
+        "13,Petro\n"));   // бракує поля
+    std::cout << "Inserted " << report.inserted << " rows, rejected " << report.errors.size() << ":" << std::endl;
+    for (const auto& err : report.errors) {
+        std::cout << "  " << (err.row == RowError::kAllRows ? "all rows" : "row " + std::to_string(err.row)) << ": "
+                  << err.message << std::endl;
+    }
+
+    std::cout << "\n--- GROUP BY ---" << std::endl;
+    for (const auto& g : orders->groupBy("user_id", {AggregateKind::Count, "id"})) {
+        std::cout << "user_id=" << g.key << " -> orders: " << *g.value << std::endl;
+    }
+    // У Sam і Taras вік не задано: їхній MIN - NULL, а не INT64_MAX
+    for (const auto& g : users->groupBy("name", {AggregateKind::Min, "age"})) {
+        std::cout << "name=" << g.key << " -> min age: ";
+        if (g.value) std::cout << *g.value << std::endl;
+        else std::cout << "NULL" << std::endl;
+    }
+
+    auto spring = orders->aggregateWhere({AggregateKind::Count, "id"}, {{"placed", "2024-03-01", "2024-05-31"}});
+    std::cout << "orders placed in spring 2024: " << spring.value_or(0) << std::endl;
+    auto adults = users->aggregateWhere({AggregateKind::Avg, "age"}, {{"age", "30", ""}});
+    std::cout << "AVG age where age >= 30: " << adults.value_or(0) << std::endl; // (30 + 41) / 2 = 35.5
+    std::cout << "users named Olena: " << users->countEqual("name", "Olena") << std::endl;
+
     std::cout << "\n--- Final Statistics ---" << std::endl;
-    // count("age") поверне 2, оскільки у "Sam" немає віку
+    // count("age") поверне 3: у "Sam" і "Taras" немає віку
     std::cout << "COUNT age: " << users->count("age") << std::endl; 
-    std::cout << "SUM age: " << users->sum("age") << std::endl;   // 25 + 30 = 55
-    // avg("age") має бути 55 / 2 = 27.5
+    std::cout << "SUM age: " << users->sum("age") << std::endl;   // 25 + 30 + 41 = 96
+    // avg("age") має бути 96 / 3 = 32
     std::cout << "AVG age: " << users->avg("age") << std::endl;   
+    std::cout << "MIN age: " << users->min("age").value_or(0) << std::endl; // 25
+    std::cout << "MAX age: " << users->max("age").value_or(0) << std::endl; // 41
+
+    // Знімок бази можна відкрити командою ./main load lab4.snapshot
+    db.snapshot("lab4.snapshot");
+    std::cout << "\nSnapshot written to lab4.snapshot" << std::endl;
 
     return 0;
 }